@@ -12,7 +12,7 @@ struct jc_error {
 };
 
 
-#define JC_ERRCNT 9
+#define JC_ERRCNT 18
 static const int errcnt = JC_ERRCNT;
 static const struct jc_error jc_error_list[JC_ERRCNT + 1] = {
 	{ "no_error",    "success" },  // 0 - not a real error
@@ -24,7 +24,16 @@ static const struct jc_error jc_error_list[JC_ERRCNT + 1] = {
 	{ "bad_argv",    "bad argv pointer" },  // 6
 	{ "wc2mb_fail",  "WideCharToMultiByte() failed" },  // 7
 	{ "alarm_fail",  "alarm call failed" },  // 8
-	{ NULL, NULL },  // 9
+	{ "bad_kernel",  "hash kernel not available" },  // 9
+	{ "open_fail",   "couldn't open file" },  // 10
+	{ "read_fail",   "file read failed" },  // 11
+	{ "no_memory",   "memory allocation failed" },  // 12
+	{ "bad_state",   "saved hash state is invalid" },  // 13
+	{ "file_changed", "file doesn't match saved hash state" },  // 14
+	{ "write_fail",  "file write failed" },  // 15
+	{ "cache_full",  "hash cache is full" },  // 16
+	{ "bad_cache",   "hash cache is invalid or incompatible" },  // 17
+	{ NULL, NULL },  // 18
 };
 
 
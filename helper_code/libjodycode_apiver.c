@@ -23,5 +23,7 @@ int main(void)
 	printf("WIN_UNICODE: %d\n", LIBJODYCODE_WIN_UNICODE_VER);
 	printf("ERROR: %d\n", LIBJODYCODE_ERROR_VER);
 	printf("ALARM: %d\n", LIBJODYCODE_ALARM_VER);
+	printf("HASHTABLE: %d\n", LIBJODYCODE_HASHTABLE_VER);
+	printf("COMPARE: %d\n", LIBJODYCODE_COMPARE_VER);
 	return 0;
 }
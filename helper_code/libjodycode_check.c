@@ -77,6 +77,14 @@ const int jc_build_min_featurelevel = MY_FEATURELEVEL_REQ;
  #undef MY_ALARM_REQ
  #define MY_ALARM_REQ LIBJODYCODE_ALARM_VER
 #endif
+#if MY_HASHTABLE_REQ == 255
+ #undef MY_HASHTABLE_REQ
+ #define MY_HASHTABLE_REQ LIBJODYCODE_HASHTABLE_VER
+#endif
+#if MY_COMPARE_REQ == 255
+ #undef MY_COMPARE_REQ
+ #define MY_COMPARE_REQ LIBJODYCODE_COMPARE_VER
+#endif
 
 
 const unsigned char jc_build_api_versiontable[] = {
@@ -92,6 +100,8 @@ const unsigned char jc_build_api_versiontable[] = {
 	MY_WIN_UNICODE_REQ,
 	MY_ERROR_REQ,
 	MY_ALARM_REQ,
+	MY_HASHTABLE_REQ,
+	MY_COMPARE_REQ,
 	255
 };
 
@@ -108,6 +118,8 @@ const char *jc_versiontable_section[] = {
 	"win_unicode",
 	"error",
 	"alarm",
+	"hashtable",
+	"compare",
 	NULL
 };
 
@@ -34,3 +34,5 @@
 #define MY_WIN_UNICODE_REQ 0
 #define MY_ERROR_REQ       0
 #define MY_ALARM_REQ       0
+#define MY_HASHTABLE_REQ   0
+#define MY_COMPARE_REQ     0
@@ -11,3 +11,28 @@ extern int jc_block_hash(jodyhash_t *data, jodyhash_t *hash, const size_t count)
 {
 	return jody_block_hash(data, hash, count);
 }
+
+extern int jc_block_hash_multi(jodyhash_t * const *data, jodyhash_t *hash, const size_t buffers, const size_t count)
+{
+	return jody_block_hash_multi((const jodyhash_t * const *)data, hash, buffers, count);
+}
+
+extern int jc_block_hash_wide(const void *data, jodyhash_t *hash, const size_t count)
+{
+	return jody_block_hash_wide((const jodyhash_t *)data, hash, count);
+}
+
+extern int jc_block_hash128(const jodyhash_t *data, jodyhash_t *hash, const size_t count)
+{
+	return jody_block_hash128(data, hash, count);
+}
+
+extern int jc_set_hash_kernel(const int kernel)
+{
+	return jody_hash_set_kernel(kernel);
+}
+
+extern int jc_get_hash_kernel(void)
+{
+	return jody_hash_get_kernel();
+}
@@ -0,0 +1,416 @@
+/* Byte-for-byte file comparison
+ *
+ * Confirms that two files (or the first part of them) are identical
+ * after their hashes match. Data is compared with the jody_hash kernel's
+ * SIMD compare loop, which stops at the first difference, and the tail
+ * and head of the files can be sampled first so files that differ near
+ * the end fail without reading everything in between.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef ON_WINDOWS
+ #include <sys/mman.h>
+#endif
+#include "likely_unlikely.h"
+#include "jody_hash.h"
+#include "libjodycode.h"
+
+/* Size of each of the two read buffers */
+#define CMP_BUF_SIZE     1048576
+/* Size of the head and tail samples */
+#define CMP_SAMPLE       65536
+/* Automatic mode maps files at least this large instead of reading them */
+#define CMP_MMAP_MIN     16777216
+/* Size of each mapped window of each file */
+#define CMP_MMAP_WINDOW  67108864
+#define CMP_ALIGN        4096
+/* Group comparison block size and default limit on open files/buffers */
+#define CMP_GROUP_BLOCK  1048576
+#define CMP_GROUP_OPEN   32
+#define CMP_GROUP_OPEN_MAX 4096
+
+#ifndef O_BINARY
+ #define O_BINARY 0
+#endif
+
+/* A run of files in the group order that matched up to 'offset' */
+struct cmp_range {
+	size_t lo;
+	size_t hi;
+	off_t offset;
+};
+
+
+/* pread() with EINTR handling that only comes up short at EOF */
+static ssize_t read_full(int fd, unsigned char *buf, size_t count, off_t offset)
+{
+	size_t done = 0;
+	ssize_t i;
+
+	while (done < count) {
+#ifdef ON_WINDOWS
+		if (lseek(fd, offset + (off_t)done, SEEK_SET) == -1) return -1;
+		i = read(fd, buf + done, (unsigned int)(count - done));
+#else
+		i = pread(fd, buf + done, count - done, offset + (off_t)done);
+#endif
+		if (i < 0 && errno == EINTR) continue;
+		if (i < 0) return -1;
+		if (i == 0) break;
+		done += (size_t)i;
+	}
+	return (ssize_t)done;
+}
+
+
+static unsigned char *alloc_aligned(size_t size)
+{
+#ifdef ON_WINDOWS
+	return (unsigned char *)malloc(size);
+#else
+	void *p;
+
+	if (posix_memalign(&p, CMP_ALIGN, size) != 0) return NULL;
+	return (unsigned char *)p;
+#endif
+}
+
+
+/* Compare [offset, end) of both files with read buffers; returns 0 if the
+ * range matches or 1 with *diff set to the first difference */
+static int cmp_range_pread(int fd_a, int fd_b, off_t offset, const off_t end,
+		unsigned char *buf_a, unsigned char *buf_b, const size_t bufsize, off_t *diff)
+{
+	ssize_t got_a, got_b;
+	size_t want, same;
+
+	while (offset < end) {
+		want = bufsize;
+		if ((uint64_t)(end - offset) < want) want = (size_t)(end - offset);
+		got_a = read_full(fd_a, buf_a, want, offset);
+		got_b = read_full(fd_b, buf_b, want, offset);
+		if (got_a < 0 || got_b < 0) return -11;
+		if (got_b < got_a) got_a = got_b;
+		same = jody_memdiff(buf_a, buf_b, (size_t)got_a);
+		/* A short read means a file shrank while it was being compared */
+		if (same < want) {
+			*diff = offset + (off_t)same;
+			return 1;
+		}
+		offset += (off_t)want;
+	}
+	return 0;
+}
+
+
+#ifndef ON_WINDOWS
+/* Compare [offset, end) of both files through mappings; returns -2 if the
+ * files can't be mapped so the caller can read them instead */
+static int cmp_range_mmap(int fd_a, int fd_b, off_t offset, const off_t end, off_t *diff)
+{
+	/* Not cached in a static since comparisons can run on many threads */
+	const long pagesize = sysconf(_SC_PAGESIZE);
+	unsigned char *map_a, *map_b;
+	off_t base, skip;
+	size_t maplen, same;
+
+	if (pagesize <= 0) return -2;
+
+	while (offset < end) {
+		skip = offset % pagesize;
+		base = offset - skip;
+		maplen = CMP_MMAP_WINDOW;
+		if ((uint64_t)(end - base) < maplen) maplen = (size_t)(end - base);
+		map_a = (unsigned char *)mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd_a, base);
+		if (map_a == MAP_FAILED) return -2;
+		map_b = (unsigned char *)mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd_b, base);
+		if (map_b == MAP_FAILED) {
+			munmap(map_a, maplen);
+			return -2;
+		}
+#ifdef MADV_SEQUENTIAL
+		madvise(map_a, maplen, MADV_SEQUENTIAL);
+		madvise(map_b, maplen, MADV_SEQUENTIAL);
+#endif
+		same = jody_memdiff(map_a + skip, map_b + skip, maplen - (size_t)skip);
+		munmap(map_a, maplen);
+		munmap(map_b, maplen);
+		if (same < maplen - (size_t)skip) {
+			*diff = offset + (off_t)same;
+			return 1;
+		}
+		offset = base + (off_t)maplen;
+	}
+	return 0;
+}
+#endif /* ON_WINDOWS */
+
+
+/* Offset of the first byte that differs between two buffers, or count
+ * if they are identical */
+extern size_t jc_memdiff(const void *a, const void *b, const size_t count)
+{
+	return jody_memdiff(a, b, count);
+}
+
+
+/* Compare the first 'length' bytes of two files (0 = the whole files)
+ * Returns 0 if they are identical, 1 if not, or a negative error. When
+ * the sizes differ no data is read and *diff is the shorter size; with
+ * JC_COMPARE_SAMPLE, *diff is a differing offset but maybe not the first. */
+extern int jc_files_equal(int fd_a, int fd_b, off_t length, int flags, off_t *diff)
+{
+	struct stat st_a, st_b;
+	unsigned char *buf_a, *buf_b;
+	size_t bufsize = CMP_BUF_SIZE;
+	off_t end_a, end_b, start = 0, end, tail;
+	off_t where = 0;
+	int i, use_mmap = 0;
+
+	if (unlikely(fd_a < 0 || fd_b < 0 || length < 0)) return -1;
+	if (fstat(fd_a, &st_a) != 0 || fstat(fd_b, &st_b) != 0) return -11;
+	end_a = st_a.st_size;
+	end_b = st_b.st_size;
+	if (length != 0) {
+		if (end_a > length) end_a = length;
+		if (end_b > length) end_b = length;
+	}
+	if (end_a != end_b) {
+		if (diff != NULL) *diff = (end_a < end_b) ? end_a : end_b;
+		return 1;
+	}
+	end = tail = end_a;
+	if (end == 0) return 0;
+
+#ifndef ON_WINDOWS
+	if ((flags & JC_COMPARE_MMAP) || (!(flags & JC_COMPARE_PREAD) && end >= CMP_MMAP_MIN)) use_mmap = 1;
+#endif
+	if (use_mmap) bufsize = CMP_SAMPLE;
+	if ((uint64_t)end < bufsize) bufsize = ((size_t)end + CMP_ALIGN - 1) & ~((size_t)CMP_ALIGN - 1);
+	buf_a = alloc_aligned(bufsize);
+	buf_b = alloc_aligned(bufsize);
+	if (unlikely(buf_a == NULL || buf_b == NULL)) {
+		free(buf_a);
+		free(buf_b);
+		return -12;
+	}
+
+	/* Files that differ often differ at the end (appended or truncated
+	 * data, trailers, checksums) or at the start (headers), so check
+	 * those first; the full pass then skips what was already checked */
+	if ((flags & JC_COMPARE_SAMPLE) && end > CMP_SAMPLE * 4) {
+		tail = (end - CMP_SAMPLE) & ~((off_t)CMP_ALIGN - 1);
+		i = cmp_range_pread(fd_a, fd_b, tail, end, buf_a, buf_b, bufsize, &where);
+		if (i == 0) i = cmp_range_pread(fd_a, fd_b, 0, CMP_SAMPLE, buf_a, buf_b, bufsize, &where);
+		if (i != 0) goto done;
+		start = CMP_SAMPLE;
+	}
+
+	i = -2;
+#ifndef ON_WINDOWS
+	if (use_mmap) i = cmp_range_mmap(fd_a, fd_b, start, tail, &where);
+#endif
+	if (i == -2) i = cmp_range_pread(fd_a, fd_b, start, tail, buf_a, buf_b, bufsize, &where);
+
+done:
+	free(buf_a);
+	free(buf_b);
+	if (i == 1 && diff != NULL) *diff = where;
+	return i;
+}
+
+
+/* Close a group file's descriptor if this code opened it */
+static void group_close(const struct jc_compare_file *file, int *fd, unsigned int *open_count)
+{
+	if (*fd >= 0 && *fd != file->fd) {
+		close(*fd);
+		(*open_count)--;
+	}
+	*fd = -1;
+	return;
+}
+
+
+/* Members of a finished subgroup all get the lowest index in it */
+static void group_finish(struct jc_compare_file *files, const size_t *order, const size_t lo, const size_t hi,
+		int *fds, unsigned int *open_count)
+{
+	size_t group = order[lo];
+
+	for (size_t k = lo + 1; k < hi; k++) if (order[k] < group) group = order[k];
+	for (size_t k = lo; k < hi; k++) {
+		files[order[k]].group = group;
+		group_close(&files[order[k]], &fds[order[k]], open_count);
+	}
+	return;
+}
+
+
+/* Sort out which files in a group of candidates are really identical.
+ * All files are read in lockstep one block at a time, and the group is
+ * split into subgroups whenever a block differs, so every byte of every
+ * file is read only once. 'length' limits how much is compared (0 = to
+ * EOF). At most 'max_open' (0 = default) files opened from paths are
+ * kept open and at most that many blocks are buffered at once.
+ * On return files[i].group is the lowest index of the files that are
+ * identical to files[i]. Returns the number of files that failed. */
+extern int jc_files_group(struct jc_compare_file *files, const size_t count, const off_t length, unsigned int max_open)
+{
+	struct cmp_range *stack = NULL, r;
+	unsigned char **bufs = NULL;
+	size_t *order = NULL, *tmp = NULL, *rep_len = NULL, *class_start = NULL;
+	size_t top = 0, nclasses, want, k, c, i;
+	unsigned int *cls = NULL, open_count = 0;
+	int *fds = NULL;
+	ssize_t got;
+	int failed = 0, fd, keep;
+
+	if (unlikely(files == NULL && count != 0)) return -1;
+	if (max_open == 0) max_open = CMP_GROUP_OPEN;
+	if (max_open > CMP_GROUP_OPEN_MAX) max_open = CMP_GROUP_OPEN_MAX;
+	for (i = 0; i < count; i++) {
+		files[i].group = i;
+		files[i].status = 0;
+	}
+	if (count < 2) return 0;
+
+	/* One class per buffer plus a leftover class for files that didn't
+	 * fit when there were too many different blocks */
+	order = (size_t *)malloc(count * sizeof(size_t));
+	tmp = (size_t *)malloc(count * sizeof(size_t));
+	cls = (unsigned int *)malloc(count * sizeof(unsigned int));
+	fds = (int *)malloc(count * sizeof(int));
+	stack = (struct cmp_range *)malloc(count * sizeof(struct cmp_range));
+	bufs = (unsigned char **)calloc(max_open + 1, sizeof(unsigned char *));
+	rep_len = (size_t *)malloc(max_open * sizeof(size_t));
+	class_start = (size_t *)malloc((max_open + 3) * sizeof(size_t));
+	if (unlikely(order == NULL || tmp == NULL || cls == NULL || fds == NULL || stack == NULL
+			|| bufs == NULL || rep_len == NULL || class_start == NULL)) {
+		failed = -12;
+		goto done;
+	}
+	for (i = 0; i < count; i++) {
+		order[i] = i;
+		fds[i] = files[i].fd;
+	}
+	stack[top].lo = 0;
+	stack[top].hi = count;
+	stack[top].offset = 0;
+	top++;
+
+	while (top > 0) {
+		r = stack[--top];
+		while (1) {
+			want = CMP_GROUP_BLOCK;
+			if (length != 0 && (uint64_t)(length - r.offset) < want) want = (size_t)(length - r.offset);
+
+			/* Read each member's block and sort it into a class; the
+			 * scratch buffer becomes the new class's buffer if no
+			 * existing class matches, so nothing is copied */
+			nclasses = 0;
+			for (k = r.lo; k < r.hi; k++) {
+				i = order[k];
+				if (bufs[nclasses] == NULL) bufs[nclasses] = alloc_aligned(CMP_GROUP_BLOCK);
+				if (unlikely(bufs[nclasses] == NULL)) {
+					failed = -12;
+					goto done;
+				}
+				fd = fds[i];
+				keep = 1;
+				if (fd < 0) {
+					if (files[i].path == NULL) {
+						files[i].status = -1;
+						cls[k] = max_open + 1;
+						continue;
+					}
+					fd = open(files[i].path, O_RDONLY | O_BINARY);
+					if (fd < 0) {
+						files[i].status = -10;
+						cls[k] = max_open + 1;
+						continue;
+					}
+					if (open_count < max_open) {
+						fds[i] = fd;
+						open_count++;
+					} else keep = 0;
+				}
+				got = read_full(fd, bufs[nclasses], want, r.offset);
+				if (!keep) close(fd);
+				if (got < 0) {
+					files[i].status = -11;
+					cls[k] = max_open + 1;
+					group_close(&files[i], &fds[i], &open_count);
+					continue;
+				}
+				for (c = 0; c < nclasses; c++)
+					if (rep_len[c] == (size_t)got && jody_memdiff(bufs[c], bufs[nclasses], (size_t)got) == (size_t)got) break;
+				if (c == nclasses) {
+					if (nclasses == max_open) c = max_open;
+					else rep_len[nclasses++] = (size_t)got;
+				}
+				cls[k] = (unsigned int)c;
+			}
+
+			/* Everything still matches: keep going without reordering */
+			for (k = r.lo; k < r.hi; k++) if (cls[k] != 0) break;
+			if (k == r.hi && rep_len[0] == CMP_GROUP_BLOCK && (length == 0 || r.offset + CMP_GROUP_BLOCK < length)) {
+				r.offset += CMP_GROUP_BLOCK;
+				continue;
+			}
+			break;
+		}
+
+		/* Split the range by class (counting sort keeps file order);
+		 * class max_open is the leftovers and max_open + 1 the failures */
+		memset(class_start, 0, (max_open + 3) * sizeof(size_t));
+		for (k = r.lo; k < r.hi; k++) class_start[cls[k] + 1]++;
+		for (c = 1; c < max_open + 3; c++) class_start[c] += class_start[c - 1];
+		for (k = r.lo; k < r.hi; k++) tmp[r.lo + class_start[cls[k]]++] = order[k];
+		memcpy(order + r.lo, tmp + r.lo, (r.hi - r.lo) * sizeof(size_t));
+		/* The sort left class_start[c] at the end of class c */
+		for (c = max_open + 2; c > 0; c--) class_start[c] = class_start[c - 1];
+		class_start[0] = 0;
+
+		for (c = 0; c <= max_open; c++) {
+			const size_t lo = r.lo + class_start[c], hi = r.lo + class_start[c + 1];
+			size_t n = hi - lo;
+
+			if (n == 0) continue;
+			/* Short blocks mean EOF (or 'length') was reached */
+			if (n == 1 || (c < max_open && (rep_len[c] < CMP_GROUP_BLOCK
+					|| (length != 0 && r.offset + CMP_GROUP_BLOCK >= length)))) {
+				group_finish(files, order, lo, hi, fds, &open_count);
+				continue;
+			}
+			stack[top].lo = lo;
+			stack[top].hi = hi;
+			stack[top].offset = (c < max_open) ? r.offset + CMP_GROUP_BLOCK : r.offset;
+			top++;
+		}
+	}
+
+done:
+	if (fds != NULL) for (i = 0; i < count; i++) group_close(&files[i], &fds[i], &open_count);
+	if (bufs != NULL) for (i = 0; i <= max_open; i++) free(bufs[i]);
+	free(bufs);
+	free(order);
+	free(tmp);
+	free(cls);
+	free(fds);
+	free(stack);
+	free(rep_len);
+	free(class_start);
+	if (failed < 0) return failed;
+	for (i = 0; i < count; i++) if (files[i].status != 0) failed++;
+	return failed;
+}
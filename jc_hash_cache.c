@@ -0,0 +1,564 @@
+/* Persistent hash cache
+ *
+ * Stores partial and full jody_hash results keyed by device, inode,
+ * size and modification time so that files which haven't changed since
+ * the last run cost a stat() instead of a full read. The cache file is
+ * an open addressing table that is mapped and used in place, not parsed.
+ * New results go to an in-memory table until jc_hash_cache_save() writes
+ * a complete new file and renames it over the old one, so a crash never
+ * leaves a half-written cache behind.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef ON_WINDOWS
+ #include <sys/mman.h>
+#endif
+#include "likely_unlikely.h"
+#include "jody_hash.h"
+#include "libjodycode.h"
+
+#ifndef O_BINARY
+ #define O_BINARY 0
+#endif
+
+/* Cache file layout (all integers little-endian):
+ * Header:
+ *  0  magic "JHCACHE\0"
+ *  8  cache format version (32-bit)
+ * 12  JODY_HASH_VERSION (32-bit)
+ * 16  number of slots (64-bit, power of two)
+ * 24  number of used slots (64-bit)
+ * 32  jody_hash of header bytes 0-31
+ * 40  jody_hash of all slots
+ * Each slot; a slot with zero flags is empty:
+ *  0  st_dev          8  st_ino          16  size
+ * 24  mtime seconds  32  mtime nsec (32-bit)  36  flags (32-bit)
+ * 40  partial hash length  48  partial hash  56  full hash
+ * Slots are found by linear probing from the hash of (dev, ino) */
+#define CACHE_FORMAT 2
+#define CACHE_HEADER 64
+#define CACHE_SLOT   64
+/* Smallest table and the lookahead used by bulk lookups */
+#define CACHE_MIN_SLOTS 64
+#define CACHE_PREFETCH  8
+
+static const unsigned char cache_magic[8] = { 'J', 'H', 'C', 'A', 'C', 'H', 'E', 0 };
+
+struct jc_hash_cache {
+	char *path;
+	/* The cache file as it was when opened */
+	const unsigned char *map;
+	size_t map_len;
+	uint64_t map_slots;
+	uint64_t map_used;
+	int mapped;
+	/* One bit per file slot that was looked up (for pruning) */
+	unsigned char *touched;
+	/* Entries added since the cache was opened or saved */
+	struct jc_hash_cache_entry *overlay;
+	size_t overlay_slots;
+	size_t overlay_used;
+};
+
+
+static void put_le(unsigned char *p, uint64_t val, unsigned int bytes)
+{
+	for (unsigned int i = 0; i < bytes; i++) p[i] = (unsigned char)(val >> (i * 8));
+	return;
+}
+
+static uint64_t get_le(const unsigned char *p, unsigned int bytes)
+{
+	uint64_t val = 0;
+	while (bytes > 0) {
+		bytes--;
+		val = (val << 8) | p[bytes];
+	}
+	return val;
+}
+
+
+/* Home slot of a key; part of the file format, so it must never change */
+static uint64_t key_slot(uint64_t dev, uint64_t ino, uint64_t slots)
+{
+	unsigned char key[16];
+	jodyhash_t hash = 0;
+
+	put_le(key, dev, 8);
+	put_le(key + 8, ino, 8);
+	jody_block_hash((const jodyhash_t *)(const void *)key, &hash, 16);
+	return (uint64_t)hash & (slots - 1);
+}
+
+
+static void read_slot(const unsigned char *p, struct jc_hash_cache_entry *e)
+{
+	e->dev = get_le(p, 8);
+	e->ino = get_le(p + 8, 8);
+	e->size = get_le(p + 16, 8);
+	e->mtime = (int64_t)get_le(p + 24, 8);
+	e->mtime_nsec = (uint32_t)get_le(p + 32, 4);
+	e->flags = (uint32_t)get_le(p + 36, 4);
+	e->partial_len = get_le(p + 40, 8);
+	e->partial_hash = get_le(p + 48, 8);
+	e->full_hash = get_le(p + 56, 8);
+	return;
+}
+
+static void write_slot(unsigned char *p, const struct jc_hash_cache_entry *e)
+{
+	put_le(p, e->dev, 8);
+	put_le(p + 8, e->ino, 8);
+	put_le(p + 16, e->size, 8);
+	put_le(p + 24, (uint64_t)e->mtime, 8);
+	put_le(p + 32, e->mtime_nsec, 4);
+	put_le(p + 36, e->flags, 4);
+	put_le(p + 40, e->partial_len, 8);
+	put_le(p + 48, e->partial_hash, 8);
+	put_le(p + 56, e->full_hash, 8);
+	return;
+}
+
+
+/* Find a key in the cache file; returns the slot or map_slots if absent */
+static uint64_t map_find(const struct jc_hash_cache *cache, uint64_t dev, uint64_t ino)
+{
+	const unsigned char *p;
+	uint64_t slot, n;
+
+	if (cache->map_slots == 0) return 0;
+	slot = key_slot(dev, ino, cache->map_slots);
+	for (n = 0; n < cache->map_slots; n++) {
+		p = cache->map + CACHE_HEADER + slot * CACHE_SLOT;
+		if (get_le(p + 36, 4) == 0) break;
+		if (get_le(p, 8) == dev && get_le(p + 8, 8) == ino) return slot;
+		slot = (slot + 1) & (cache->map_slots - 1);
+	}
+	return cache->map_slots;
+}
+
+
+/* Find a key in an in-memory table, or the empty slot where it belongs */
+static struct jc_hash_cache_entry *table_slot(struct jc_hash_cache_entry *table, size_t slots, uint64_t dev, uint64_t ino)
+{
+	size_t slot = (size_t)key_slot(dev, ino, slots);
+
+	while (table[slot].flags != 0 && (table[slot].dev != dev || table[slot].ino != ino))
+		slot = (slot + 1) & (slots - 1);
+	return &table[slot];
+}
+
+
+static int overlay_grow(struct jc_hash_cache *cache)
+{
+	struct jc_hash_cache_entry *table, *e;
+	size_t slots = cache->overlay_slots ? cache->overlay_slots * 2 : CACHE_MIN_SLOTS;
+
+	table = (struct jc_hash_cache_entry *)calloc(slots, sizeof(struct jc_hash_cache_entry));
+	if (unlikely(table == NULL)) return -12;
+	for (size_t i = 0; i < cache->overlay_slots; i++) {
+		if (cache->overlay[i].flags == 0) continue;
+		e = table_slot(table, slots, cache->overlay[i].dev, cache->overlay[i].ino);
+		*e = cache->overlay[i];
+	}
+	free(cache->overlay);
+	cache->overlay = table;
+	cache->overlay_slots = slots;
+	return 0;
+}
+
+
+static int same_file(const struct jc_hash_cache_entry *a, const struct jc_hash_cache_entry *b)
+{
+	return a->size == b->size && a->mtime == b->mtime && a->mtime_nsec == b->mtime_nsec;
+}
+
+
+/* Drop the file mapping and any unsaved entries */
+static void cache_release(struct jc_hash_cache *cache)
+{
+	if (cache->map != NULL) {
+#ifndef ON_WINDOWS
+		if (cache->mapped) munmap((void *)(uintptr_t)cache->map, cache->map_len);
+		else
+#endif
+		free((void *)(uintptr_t)cache->map);
+	}
+	free(cache->touched);
+	free(cache->overlay);
+	cache->map = NULL;
+	cache->map_len = 0;
+	cache->map_slots = 0;
+	cache->map_used = 0;
+	cache->touched = NULL;
+	cache->overlay = NULL;
+	cache->overlay_slots = 0;
+	cache->overlay_used = 0;
+	return;
+}
+
+
+/* Map the cache file; a missing, damaged or outdated file is an empty cache */
+static int cache_load(struct jc_hash_cache *cache)
+{
+	struct stat st;
+	unsigned char *buf = NULL;
+	jodyhash_t check = 0;
+	uint64_t slots, used = 0;
+	int fd;
+
+	fd = open(cache->path, O_RDONLY | O_BINARY);
+	if (fd < 0) return (errno == ENOENT) ? 0 : -10;
+	if (fstat(fd, &st) != 0 || st.st_size < CACHE_HEADER || (uint64_t)st.st_size > SIZE_MAX) goto empty;
+	cache->map_len = (size_t)st.st_size;
+
+#ifndef ON_WINDOWS
+	buf = (unsigned char *)mmap(NULL, cache->map_len, PROT_READ, MAP_SHARED, fd, 0);
+	if (buf == MAP_FAILED) buf = NULL;
+	else cache->mapped = 1;
+#endif
+	if (buf == NULL) {
+		buf = (unsigned char *)malloc(cache->map_len);
+		if (unlikely(buf == NULL)) goto empty;
+		cache->mapped = 0;
+		if (read(fd, buf, (unsigned int)cache->map_len) != (ssize_t)cache->map_len) {
+			free(buf);
+			goto empty;
+		}
+	}
+	close(fd);
+	cache->map = buf;
+
+	slots = get_le(buf + 16, 8);
+	jody_block_hash((const jodyhash_t *)(const void *)buf, &check, 32);
+	if (memcmp(buf, cache_magic, 8) != 0 || get_le(buf + 8, 4) != CACHE_FORMAT
+			|| get_le(buf + 12, 4) != JODY_HASH_VERSION || get_le(buf + 32, 8) != check
+			|| slots == 0 || (slots & (slots - 1)) != 0
+			|| slots > (cache->map_len - CACHE_HEADER) / CACHE_SLOT
+			|| cache->map_len != CACHE_HEADER + slots * CACHE_SLOT) {
+		cache_release(cache);
+		return 0;
+	}
+	/* The slots must match their checksum and the used count, since the
+	 * used count sizes the tables they are merged into when saving */
+	check = 0;
+	jody_block_hash((const jodyhash_t *)(const void *)(buf + CACHE_HEADER), &check, (size_t)slots * CACHE_SLOT);
+	for (uint64_t slot = 0; slot < slots; slot++)
+		if (get_le(buf + CACHE_HEADER + slot * CACHE_SLOT + 36, 4) != 0) used++;
+	if (get_le(buf + 40, 8) != check || get_le(buf + 24, 8) != used) {
+		cache_release(cache);
+		return 0;
+	}
+	cache->map_slots = slots;
+	cache->map_used = used;
+	cache->touched = (unsigned char *)calloc((size_t)((slots + 7) / 8), 1);
+	if (unlikely(cache->touched == NULL)) {
+		cache_release(cache);
+		return -12;
+	}
+	return 0;
+
+empty:
+	close(fd);
+	cache->map_len = 0;
+	return 0;
+}
+
+
+/* Open a cache file; it doesn't need to exist until the first save */
+extern int jc_hash_cache_open(const char *path, struct jc_hash_cache **cache)
+{
+	struct jc_hash_cache *c;
+	int i;
+
+	if (unlikely(path == NULL || cache == NULL)) return -1;
+	*cache = NULL;
+	c = (struct jc_hash_cache *)calloc(1, sizeof(struct jc_hash_cache));
+	if (unlikely(c == NULL)) return -12;
+	c->path = (char *)malloc(strlen(path) + 1);
+	if (unlikely(c->path == NULL)) {
+		free(c);
+		return -12;
+	}
+	strcpy(c->path, path);
+	i = cache_load(c);
+	if (i != 0) {
+		free(c->path);
+		free(c);
+		return i;
+	}
+	*cache = c;
+	return 0;
+}
+
+
+/* Close a cache without saving it */
+extern void jc_hash_cache_close(struct jc_hash_cache *cache)
+{
+	if (cache == NULL) return;
+	cache_release(cache);
+	free(cache->path);
+	free(cache);
+	return;
+}
+
+
+#ifndef ON_WINDOWS
+/* Fill in the key fields of an entry from stat() information */
+extern void jc_hash_cache_set_key(struct jc_hash_cache_entry *entry, const struct stat *st)
+{
+	memset(entry, 0, sizeof(struct jc_hash_cache_entry));
+	entry->dev = (uint64_t)st->st_dev;
+	entry->ino = (uint64_t)st->st_ino;
+	entry->size = (uint64_t)st->st_size;
+	entry->mtime = (int64_t)st->st_mtime;
+ #if defined __APPLE__
+	entry->mtime_nsec = (uint32_t)st->st_mtimespec.tv_nsec;
+ #elif defined _POSIX_C_SOURCE && _POSIX_C_SOURCE >= 200809L
+	entry->mtime_nsec = (uint32_t)st->st_mtim.tv_nsec;
+ #endif
+	return;
+}
+#endif /* ON_WINDOWS */
+
+
+/* Look up the entry whose key fields are filled in; returns 0 and fills
+ * in flags and hashes if the cache has results for this exact file, or
+ * 1 with flags cleared if it doesn't */
+extern int jc_hash_cache_get(struct jc_hash_cache *cache, struct jc_hash_cache_entry *entry)
+{
+	struct jc_hash_cache_entry found;
+	uint64_t slot;
+
+	if (unlikely(cache == NULL || entry == NULL)) return -1;
+	entry->flags = 0;
+
+	if (cache->overlay_used != 0) {
+		found = *table_slot(cache->overlay, cache->overlay_slots, entry->dev, entry->ino);
+		if (found.flags != 0) goto check;
+	}
+	slot = map_find(cache, entry->dev, entry->ino);
+	if (slot >= cache->map_slots) return 1;
+	cache->touched[slot / 8] = (unsigned char)(cache->touched[slot / 8] | (1U << (slot % 8)));
+	read_slot(cache->map + CACHE_HEADER + slot * CACHE_SLOT, &found);
+
+check:
+	/* A changed file has the same key but different size or mtime */
+	if (!same_file(entry, &found)) return 1;
+	entry->flags = found.flags;
+	entry->partial_len = found.partial_len;
+	entry->partial_hash = found.partial_hash;
+	entry->full_hash = found.full_hash;
+	return 0;
+}
+
+
+/* Look up many entries; cache file slots are prefetched a few entries
+ * ahead so the lookups don't wait on each other. Returns the hit count. */
+extern size_t jc_hash_cache_get_many(struct jc_hash_cache *cache, struct jc_hash_cache_entry *entries, const size_t count)
+{
+	size_t hits = 0;
+
+	if (unlikely(cache == NULL || entries == NULL)) return 0;
+	for (size_t i = 0; i < count; i++) {
+#if defined __GNUC__ || defined __clang__
+		if (i + CACHE_PREFETCH < count && cache->map_slots != 0)
+			__builtin_prefetch(cache->map + CACHE_HEADER + CACHE_SLOT
+					* key_slot(entries[i + CACHE_PREFETCH].dev, entries[i + CACHE_PREFETCH].ino, cache->map_slots));
+#endif
+		if (jc_hash_cache_get(cache, &entries[i]) == 0) hits++;
+	}
+	return hits;
+}
+
+
+/* Add or update an entry; results for the same unchanged file are merged,
+ * so a full hash can be added to an entry that only had a partial hash */
+extern int jc_hash_cache_put(struct jc_hash_cache *cache, const struct jc_hash_cache_entry *entry)
+{
+	struct jc_hash_cache_entry *e, old;
+	int i;
+
+	if (unlikely(cache == NULL || entry == NULL)) return -1;
+	if (entry->flags == 0) return 0;
+	if ((cache->overlay_used + 1) * 2 > cache->overlay_slots) {
+		i = overlay_grow(cache);
+		if (i != 0) return i;
+	}
+
+	e = table_slot(cache->overlay, cache->overlay_slots, entry->dev, entry->ino);
+	if (e->flags == 0) {
+		cache->overlay_used++;
+		/* Start from what the cache file already knows */
+		old = *entry;
+		if (jc_hash_cache_get(cache, &old) == 0) *e = old;
+	}
+	if (e->flags != 0 && !same_file(e, entry)) e->flags = 0;
+	e->dev = entry->dev;
+	e->ino = entry->ino;
+	e->size = entry->size;
+	e->mtime = entry->mtime;
+	e->mtime_nsec = entry->mtime_nsec;
+	if (entry->flags & JC_HASH_CACHE_PARTIAL) {
+		e->partial_len = entry->partial_len;
+		e->partial_hash = entry->partial_hash;
+	}
+	if (entry->flags & JC_HASH_CACHE_FULL) e->full_hash = entry->full_hash;
+	e->flags |= entry->flags & (JC_HASH_CACHE_PARTIAL | JC_HASH_CACHE_FULL);
+	return 0;
+}
+
+
+static int write_all(int fd, const unsigned char *buf, size_t len)
+{
+	ssize_t i;
+
+	while (len > 0) {
+		i = write(fd, buf, (len > 0x40000000) ? 0x40000000 : (unsigned int)len);
+		if (i < 0 && errno == EINTR) continue;
+		if (i <= 0) return -15;
+		buf += i;
+		len -= (size_t)i;
+	}
+	return 0;
+}
+
+
+#ifndef ON_WINDOWS
+/* Sync the directory holding a file so a rename in it is durable */
+static void sync_dir(const char *path)
+{
+	char *dir;
+	const char *slash = strrchr(path, '/');
+	int fd;
+
+	if (slash == NULL) {
+		fd = open(".", O_RDONLY);
+	} else {
+		dir = (char *)malloc((size_t)(slash - path) + 2);
+		if (dir == NULL) return;
+		memcpy(dir, path, (size_t)(slash - path) + 1);
+		dir[(slash - path) + 1] = '\0';
+		fd = open(dir, O_RDONLY);
+		free(dir);
+	}
+	if (fd < 0) return;
+	fsync(fd);
+	close(fd);
+	return;
+}
+#endif /* ON_WINDOWS */
+
+
+/* Write the cache to disk: a new file is written and synced, then renamed
+ * over the old one. JC_HASH_CACHE_SAVE_PRUNE drops entries for files that
+ * were never looked up or added since the cache was opened. */
+extern int jc_hash_cache_save(struct jc_hash_cache *cache, const int flags)
+{
+	struct jc_hash_cache_entry *table, *e, entry;
+#ifndef ON_WINDOWS
+	struct stat st;
+#endif
+	unsigned char *buf = NULL;
+	char *tmp = NULL;
+	uint64_t slots = CACHE_MIN_SLOTS, used = 0, slot;
+	jodyhash_t check = 0;
+	size_t len;
+	int fd, i = -12;
+
+	if (unlikely(cache == NULL)) return -1;
+
+	/* Keep the table at most half full so probe runs stay short */
+	while (slots < (cache->map_used + cache->overlay_used) * 2) slots *= 2;
+	if (slots > (SIZE_MAX - CACHE_HEADER) / CACHE_SLOT) return -12;
+	table = (struct jc_hash_cache_entry *)calloc((size_t)slots, sizeof(struct jc_hash_cache_entry));
+	if (unlikely(table == NULL)) return -12;
+
+	/* New entries win over the ones from the file */
+	for (size_t j = 0; j < cache->overlay_slots; j++) {
+		if (cache->overlay[j].flags == 0) continue;
+		e = table_slot(table, (size_t)slots, cache->overlay[j].dev, cache->overlay[j].ino);
+		*e = cache->overlay[j];
+		used++;
+	}
+	for (slot = 0; slot < cache->map_slots; slot++) {
+		if ((flags & JC_HASH_CACHE_SAVE_PRUNE) && !(cache->touched[slot / 8] & (1U << (slot % 8)))) continue;
+		read_slot(cache->map + CACHE_HEADER + slot * CACHE_SLOT, &entry);
+		if (entry.flags == 0) continue;
+		e = table_slot(table, (size_t)slots, entry.dev, entry.ino);
+		if (e->flags != 0) continue;
+		*e = entry;
+		used++;
+	}
+
+	len = CACHE_HEADER + (size_t)slots * CACHE_SLOT;
+	buf = (unsigned char *)calloc(len, 1);
+	tmp = (char *)malloc(strlen(cache->path) + 8);
+	if (unlikely(buf == NULL || tmp == NULL)) goto out;
+	memcpy(buf, cache_magic, 8);
+	put_le(buf + 8, CACHE_FORMAT, 4);
+	put_le(buf + 12, JODY_HASH_VERSION, 4);
+	put_le(buf + 16, slots, 8);
+	put_le(buf + 24, used, 8);
+	jody_block_hash((const jodyhash_t *)(const void *)buf, &check, 32);
+	put_le(buf + 32, check, 8);
+	for (slot = 0; slot < slots; slot++)
+		if (table[slot].flags != 0) write_slot(buf + CACHE_HEADER + slot * CACHE_SLOT, &table[slot]);
+	check = 0;
+	jody_block_hash((const jodyhash_t *)(const void *)(buf + CACHE_HEADER), &check, (size_t)slots * CACHE_SLOT);
+	put_le(buf + 40, check, 8);
+
+	/* Every save gets its own temporary file so that two processes saving
+	 * the same cache can't write into each other's file */
+	strcpy(tmp, cache->path);
+#ifdef ON_WINDOWS
+	strcat(tmp, ".tmp");
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+#else
+	strcat(tmp, ".XXXXXX");
+	fd = mkstemp(tmp);
+	/* mkstemp() makes the file private; keep the old cache's permissions */
+	if (fd >= 0) fchmod(fd, (stat(cache->path, &st) == 0) ? (st.st_mode & 07777) : 0644);
+#endif
+	if (fd < 0) {
+		i = -10;
+		goto out;
+	}
+	i = write_all(fd, buf, len);
+#ifndef ON_WINDOWS
+	if (i == 0 && fsync(fd) != 0) i = -15;
+#endif
+	close(fd);
+#ifdef ON_WINDOWS
+	/* Windows can't rename over an existing file */
+	if (i == 0) remove(cache->path);
+#endif
+	if (i == 0 && rename(tmp, cache->path) != 0) i = -15;
+	if (i != 0) {
+		remove(tmp);
+		goto out;
+	}
+#ifndef ON_WINDOWS
+	sync_dir(cache->path);
+#endif
+
+	/* Switch over to the file that was just written */
+	cache_release(cache);
+	i = cache_load(cache);
+
+out:
+	free(tmp);
+	free(buf);
+	free(table);
+	return i;
+}
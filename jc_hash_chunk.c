@@ -0,0 +1,184 @@
+/* Content-defined chunking for jody_hash
+ *
+ * Splits data into variable-sized chunks at points chosen by a gear
+ * rolling hash (FastCDC style) and reports the offset, length and
+ * jody_hash of each chunk. Because the cut points depend only on the
+ * nearby content, inserting or deleting bytes only changes the chunks
+ * around the edit, so duplicated regions inside and between files
+ * produce identical chunk hashes even when they are not aligned.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "likely_unlikely.h"
+#include "jody_hash.h"
+#include "libjodycode.h"
+
+/* Read buffer for jc_hash_chunk_fd(); always holds several max-sized chunks */
+#define CHUNK_BUF_SIZE 4194304
+/* The normal mask must keep a few bits, so the average has a floor */
+#define CHUNK_AVG_MIN  256
+#define CHUNK_MAX_MAX  1073741824
+
+struct chunk_params {
+	size_t min;
+	size_t avg;
+	size_t max;
+	/* Stricter mask before the average size, looser one after; this
+	 * pulls chunk sizes toward the average ("normalized chunking") */
+	uint64_t mask_s;
+	uint64_t mask_l;
+	uint64_t gear[256];
+};
+
+
+/* Check sizes, fill in defaults and build the masks and gear table
+ * The gear table comes from a fixed generator so chunk boundaries are
+ * the same on every machine (JODY_HASH_CDC_VERSION) */
+static int chunk_setup(struct chunk_params *cp, size_t min, size_t avg, size_t max)
+{
+	uint64_t x = JODY_HASH_CONSTANT, z;
+	unsigned int bits = 0;
+
+	if (avg == 0) avg = JC_HASH_CHUNK_AVG;
+	if (min == 0) min = avg / 4;
+	if (max == 0) max = avg * 8;
+	if (avg < CHUNK_AVG_MIN || min > avg || avg > max || max > CHUNK_MAX_MAX) return -1;
+	while (((size_t)2 << bits) <= avg) bits++;
+
+	cp->min = min;
+	cp->avg = avg;
+	cp->max = max;
+	/* The high bits of a gear hash depend on the most bytes */
+	cp->mask_s = ~(uint64_t)0 << (64 - (bits + 2));
+	cp->mask_l = ~(uint64_t)0 << (64 - (bits - 2));
+
+	/* splitmix64 */
+	for (int i = 0; i < 256; i++) {
+		x += 0x9e3779b97f4a7c15ULL;
+		z = x;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		cp->gear[i] = z ^ (z >> 31);
+	}
+	return 0;
+}
+
+
+/* Length of the chunk that starts at p; 'count' bytes are available
+ * The first 'min' bytes are never scanned since they can't hold a cut */
+static size_t chunk_cut(const struct chunk_params *cp, const unsigned char *p, size_t count)
+{
+	uint64_t h = 0;
+	size_t i = cp->min, normal = cp->avg;
+
+	if (count <= cp->min) return count;
+	if (count > cp->max) count = cp->max;
+	if (normal > count) normal = count;
+
+	for (; i < normal; i++) {
+		h = (h << 1) + cp->gear[p[i]];
+		if (!(h & cp->mask_s)) return i + 1;
+	}
+	for (; i < count; i++) {
+		h = (h << 1) + cp->gear[p[i]];
+		if (!(h & cp->mask_l)) return i + 1;
+	}
+	return count;
+}
+
+
+/* Cut and hash every chunk in p[0..count); if 'more' is set, the data
+ * continues past count so a chunk that runs into the end is left over.
+ * *used is set to the number of bytes consumed. */
+static int chunk_run(const struct chunk_params *cp, const unsigned char *p, size_t count, uint64_t base, int more,
+		int (*func)(const struct jc_chunk *chunk, void *arg), void *arg, size_t *used)
+{
+	struct jc_hash_ctx ctx;
+	struct jc_chunk chunk;
+	size_t pos = 0, len;
+	int i;
+
+	while (pos < count) {
+		if (more && count - pos < cp->max) break;
+		len = chunk_cut(cp, p + pos, count - pos);
+		jc_hash_init(&ctx);
+		if (jc_hash_update(&ctx, p + pos, len) != 0) return 1;
+		chunk.offset = base + pos;
+		chunk.length = len;
+		jc_hash_final(&ctx, &chunk.hash);
+		pos += len;
+		i = func(&chunk, arg);
+		if (i != 0) {
+			*used = pos;
+			return i;
+		}
+	}
+	*used = pos;
+	return 0;
+}
+
+
+/* Chunk a buffer; func() is called for each chunk in order and a nonzero
+ * return from it stops chunking and is returned. Sizes of 0 pick the
+ * defaults (avg JC_HASH_CHUNK_AVG, min avg / 4, max avg * 8). */
+extern int jc_hash_chunk(const void *data, const size_t count, const size_t min, const size_t avg, const size_t max,
+		int (*func)(const struct jc_chunk *chunk, void *arg), void *arg)
+{
+	struct chunk_params cp;
+	size_t used;
+
+	if (unlikely((data == NULL && count != 0) || func == NULL)) return -1;
+	if (chunk_setup(&cp, min, avg, max) != 0) return -1;
+	return chunk_run(&cp, (const unsigned char *)data, count, 0, 0, func, arg, &used);
+}
+
+
+/* Chunk a file from its current position to EOF; offsets are relative to
+ * where reading started */
+extern int jc_hash_chunk_fd(int fd, const size_t min, const size_t avg, const size_t max,
+		int (*func)(const struct jc_chunk *chunk, void *arg), void *arg)
+{
+	struct chunk_params cp;
+	unsigned char *buf;
+	size_t bufsize = CHUNK_BUF_SIZE, fill = 0, used;
+	uint64_t base = 0;
+	ssize_t got;
+	int eof = 0, i = 0;
+
+	if (unlikely(fd < 0 || func == NULL)) return -1;
+	if (chunk_setup(&cp, min, avg, max) != 0) return -1;
+	if (bufsize < cp.max * 4) bufsize = cp.max * 4;
+	buf = (unsigned char *)malloc(bufsize);
+	if (unlikely(buf == NULL)) return -12;
+
+	while (!eof) {
+		while (fill < bufsize) {
+			got = read(fd, buf + fill, bufsize - fill);
+			if (got < 0 && errno == EINTR) continue;
+			if (got < 0) {
+				free(buf);
+				return -11;
+			}
+			if (got == 0) {
+				eof = 1;
+				break;
+			}
+			fill += (size_t)got;
+		}
+		i = chunk_run(&cp, buf, fill, base, !eof, func, arg, &used);
+		if (i != 0) break;
+		/* Keep the unfinished chunk at the start of the buffer */
+		memmove(buf, buf + used, fill - used);
+		fill -= used;
+		base += used;
+	}
+	free(buf);
+	return i;
+}
@@ -0,0 +1,535 @@
+/* File hashing engine for jody_hash
+ *
+ * Reads files with pread() or mmap() and feeds the data to a streaming
+ * hash context so programs don't all need their own read/hash loops.
+ * Sparse mode skips the holes in sparse files and hashes zeroes for them
+ * instead, so the I/O depends on the real data and not the file size.
+ * Direct and no-cache modes keep big scans from flushing the page cache.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+/* glibc only has SEEK_DATA, SEEK_HOLE and O_DIRECT with _GNU_SOURCE */
+#ifndef _GNU_SOURCE
+ #define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef ON_WINDOWS
+ #include <sys/mman.h>
+#endif
+#include "likely_unlikely.h"
+#include "jody_hash.h"
+#include "libjodycode.h"
+
+/* Read buffer size limits; the actual size depends on the CPU caches */
+#define HASH_BUF_MIN     65536
+#define HASH_BUF_MAX     4194304
+#define HASH_BUF_DEFAULT 1048576
+
+/* O_DIRECT needs the buffer, file offset and read size to be aligned;
+ * 4 KiB covers the logical block size of nearly every device */
+#define HASH_DIRECT_ALIGN 4096
+
+/* Modes that must not leave file data in the page cache */
+#define HASH_UNCACHED (JC_HASH_FILE_DIRECT | JC_HASH_FILE_NOCACHE)
+
+/* Automatic mode maps files at least this large instead of reading them */
+#define HASH_MMAP_MIN    16777216
+/* Size of each mapped window; limits address space and resident pages */
+#define HASH_MMAP_WINDOW 67108864
+
+#ifndef O_BINARY
+ #define O_BINARY 0
+#endif
+
+static size_t hash_bufsize = 0;
+
+/* Zeroes for partial words at the edges of holes */
+static const unsigned char zero_word[sizeof(jodyhash_t)];
+
+/* Zero-run bookkeeping for sparse mode */
+struct zero_track {
+	struct jc_hash_zero_stats *stats;
+	uint64_t run;
+};
+
+
+/* Choose a read buffer that fits in the L2 cache (or part of L3) so the
+ * data is still cached when it gets hashed after the read copies it */
+static size_t get_hash_bufsize(void)
+{
+	size_t size = 0;
+#ifdef __linux__
+	struct jc_proc_cacheinfo pci;
+
+	if (hash_bufsize != 0) return hash_bufsize;
+	jc_get_proc_cacheinfo(&pci);
+	size = pci.l2 ? pci.l2 : pci.l2d;
+	if (size == 0) size = (pci.l3 ? pci.l3 : pci.l3d) / 4;
+#else
+	if (hash_bufsize != 0) return hash_bufsize;
+#endif
+	if (size == 0) size = HASH_BUF_DEFAULT;
+	if (size < HASH_BUF_MIN) size = HASH_BUF_MIN;
+	if (size > HASH_BUF_MAX) size = HASH_BUF_MAX;
+	size &= ~((size_t)4095);
+	hash_bufsize = size;
+	return size;
+}
+
+
+/* pread() with EINTR handling; Windows has no pread() so seek + read */
+static ssize_t read_at(int fd, void *buf, size_t count, off_t offset)
+{
+	ssize_t i;
+
+	do {
+#ifdef ON_WINDOWS
+		if (lseek(fd, offset, SEEK_SET) == -1) return -1;
+		i = read(fd, buf, (unsigned int)count);
+#else
+		i = pread(fd, buf, count, offset);
+#endif
+	} while (i < 0 && errno == EINTR);
+	return i;
+}
+
+
+/* Drop data that was just read from the page cache; the range is widened
+ * to whole pages since partially covered pages are never dropped */
+static void drop_cached(int fd, off_t start, off_t end)
+{
+#ifdef POSIX_FADV_DONTNEED
+	start &= ~(off_t)(HASH_DIRECT_ALIGN - 1);
+	end = (end + HASH_DIRECT_ALIGN - 1) & ~(off_t)(HASH_DIRECT_ALIGN - 1);
+	posix_fadvise(fd, start, end - start, POSIX_FADV_DONTNEED);
+#else
+	(void)fd; (void)start; (void)end;
+#endif
+	return;
+}
+
+
+/* Hash with a read buffer; 'end' of -1 means read until EOF
+ * If 'nocache' is set, each window is dropped from the cache after use.
+ * Pipes, sockets and terminals can't be read at an offset, so they are
+ * read from wherever they are and 'offset' only counts the bytes read. */
+static int hash_fd_pread(struct jc_hash_ctx *ctx, int fd, off_t offset, off_t end, const int nocache)
+{
+	unsigned char *buf;
+	size_t bufsize = get_hash_bufsize();
+	size_t want;
+	ssize_t got;
+	int stream = 0;
+
+	/* Small files don't need a full-sized buffer */
+	if (end >= 0 && (uint64_t)(end - offset) < bufsize)
+		bufsize = ((size_t)(end - offset) + 4095) & ~((size_t)4095);
+	if (bufsize == 0) return 0;
+	buf = (unsigned char *)malloc(bufsize);
+	if (unlikely(buf == NULL)) return -12;
+
+	while (end < 0 || offset < end) {
+		want = bufsize;
+		if (end >= 0 && (uint64_t)(end - offset) < want) want = (size_t)(end - offset);
+		if (stream) {
+			do got = read(fd, buf, (unsigned int)want);
+			while (got < 0 && errno == EINTR);
+		} else got = read_at(fd, buf, want, offset);
+		if (got < 0 && errno == ESPIPE && !stream) {
+			stream = 1;
+			continue;
+		}
+		if (got < 0) {
+			free(buf);
+			return -11;
+		}
+		if (got == 0) break;
+		jc_hash_update(ctx, buf, (size_t)got);
+		if (nocache && !stream) drop_cached(fd, offset, offset + got);
+		offset += got;
+	}
+	free(buf);
+	return 0;
+}
+
+
+#if defined O_DIRECT && !defined ON_WINDOWS
+/* Read a regular file with O_DIRECT so the data never enters the page
+ * cache. O_DIRECT is turned on for the fd only while reading, unless it
+ * was already on; it is a flag of the open file, so anything else using
+ * the same file at the same time gets it too. Returns 1
+ * without hashing anything if the file system doesn't allow O_DIRECT;
+ * *offset is left at the first byte that was not hashed yet. */
+static int hash_fd_direct(struct jc_hash_ctx *ctx, int fd, off_t *offset, const off_t end)
+{
+	const int fl = fcntl(fd, F_GETFL);
+	const off_t start = *offset;
+	void *mem;
+	unsigned char *buf;
+	size_t bufsize = get_hash_bufsize(), skip, use;
+	off_t pos;
+	ssize_t got;
+	int err = 0;
+
+	if (fl < 0) return 1;
+	/* Reads start on an alignment boundary; the bytes before *offset are
+	 * read but not hashed */
+	pos = *offset & ~(off_t)(HASH_DIRECT_ALIGN - 1);
+	if ((uint64_t)(end - pos) < bufsize)
+		bufsize = ((size_t)(end - pos) + HASH_DIRECT_ALIGN - 1) & ~((size_t)HASH_DIRECT_ALIGN - 1);
+	if (posix_memalign(&mem, HASH_DIRECT_ALIGN, bufsize) != 0) return -12;
+	buf = (unsigned char *)mem;
+	if (!(fl & O_DIRECT) && fcntl(fd, F_SETFL, fl | O_DIRECT) != 0) {
+		free(buf);
+		return 1;
+	}
+
+	while (*offset < end) {
+		got = read_at(fd, buf, bufsize, pos);
+		if (got < 0) {
+			/* Some file systems only refuse O_DIRECT at read time */
+			err = (errno == EINVAL && *offset == start) ? 1 : -11;
+			break;
+		}
+		skip = (size_t)(*offset - pos);
+		if ((size_t)got <= skip) break;
+		use = (size_t)got - skip;
+		if ((uint64_t)(end - *offset) < use) use = (size_t)(end - *offset);
+		jc_hash_update(ctx, buf + skip, use);
+		*offset += (off_t)use;
+		pos += got;
+		/* Only the last read of a file can end off a block boundary */
+		if (((size_t)got & (HASH_DIRECT_ALIGN - 1)) != 0) break;
+	}
+
+	if (!(fl & O_DIRECT)) fcntl(fd, F_SETFL, fl);
+	free(buf);
+	return err;
+}
+#endif /* O_DIRECT && !ON_WINDOWS */
+
+
+#ifndef ON_WINDOWS
+/* Hash a mapped file in windows; returns 1 if mmap() can't be used and
+ * leaves *offset at the first byte that was not hashed yet */
+static int hash_fd_mmap(struct jc_hash_ctx *ctx, int fd, off_t *offset, off_t end)
+{
+	/* Not cached in a static since jc_hash_files() runs this on many threads */
+	const long pagesize = sysconf(_SC_PAGESIZE);
+	unsigned char *map;
+	off_t base, skip;
+	size_t maplen;
+
+	if (pagesize <= 0) return 1;
+
+	while (*offset < end) {
+		/* Mappings must start on a page boundary */
+		skip = *offset % pagesize;
+		base = *offset - skip;
+		maplen = HASH_MMAP_WINDOW;
+		if ((uint64_t)(end - base) < maplen) maplen = (size_t)(end - base);
+		map = (unsigned char *)mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd, base);
+		if (map == MAP_FAILED) return 1;
+#ifdef MADV_SEQUENTIAL
+		madvise(map, maplen, MADV_SEQUENTIAL);
+#endif
+		jc_hash_update(ctx, map + skip, maplen - (size_t)skip);
+		munmap(map, maplen);
+		*offset = base + (off_t)maplen;
+	}
+	return 0;
+}
+#endif /* ON_WINDOWS */
+
+
+/* Add 'len' zero bytes to a hash context; whole words are hashed without
+ * reading memory at all */
+static void hash_zeroes(struct jc_hash_ctx *ctx, uint64_t len)
+{
+	uint64_t words;
+	size_t n;
+
+	if (ctx->tail_len != 0) {
+		n = sizeof(jodyhash_t) - ctx->tail_len;
+		if (len < n) n = (size_t)len;
+		jc_hash_update(ctx, zero_word, n);
+		len -= n;
+	}
+	if (ctx->tail_len == 0) {
+		words = len / sizeof(jodyhash_t);
+		jody_block_hash_zeroes(&ctx->hash, words);
+		ctx->length += words * sizeof(jodyhash_t);
+		len -= words * sizeof(jodyhash_t);
+	}
+	if (len != 0) jc_hash_update(ctx, zero_word, (size_t)len);
+	return;
+}
+
+
+/* Extend the current run of holes and zero blocks, or end it */
+static void zero_run(struct zero_track *zt, const uint64_t len)
+{
+	if (len == 0) {
+		zt->run = 0;
+		return;
+	}
+	if (zt->run == 0) zt->stats->zero_runs++;
+	zt->run += len;
+	if (zt->run > zt->stats->longest_run) zt->stats->longest_run = zt->run;
+	return;
+}
+
+
+/* Find the all-zero JC_HASH_ZERO_BLOCK blocks in data read at 'pos'; blocks
+ * cut off by a read boundary are checked piece by piece */
+static void scan_zero_blocks(struct zero_track *zt, const unsigned char *buf, const size_t len, const off_t pos)
+{
+	size_t i = 0, piece;
+
+	while (i < len) {
+		piece = JC_HASH_ZERO_BLOCK - (size_t)((uint64_t)pos + i) % JC_HASH_ZERO_BLOCK;
+		if (piece > len - i) piece = len - i;
+		if (jody_zero_span(buf + i, piece) == piece) {
+			zt->stats->zero_bytes += piece;
+			zero_run(zt, piece);
+		} else zero_run(zt, 0);
+		i += piece;
+	}
+	return;
+}
+
+
+/* Hash [offset, end) of a regular file; data regions are read and holes
+ * are hashed as zeroes without any I/O. The file offset is put back afterward
+ * since SEEK_DATA and SEEK_HOLE move it. */
+static int hash_fd_sparse(struct jc_hash_ctx *ctx, int fd, off_t offset, const off_t end, struct jc_hash_zero_stats *stats, const int nocache)
+{
+	struct jc_hash_zero_stats unused;
+	struct zero_track zt;
+	unsigned char *buf;
+	size_t bufsize = get_hash_bufsize(), want;
+	off_t data, hole;
+	ssize_t got;
+	int err = 0;
+#if defined SEEK_DATA && defined SEEK_HOLE
+	const off_t saved = lseek(fd, 0, SEEK_CUR);
+#endif
+
+	if (stats == NULL) stats = &unused;
+	zt.stats = stats;
+	zt.run = 0;
+	if ((uint64_t)(end - offset) < bufsize)
+		bufsize = ((size_t)(end - offset) + 4095) & ~((size_t)4095);
+	buf = (unsigned char *)malloc(bufsize);
+	if (unlikely(buf == NULL)) return -12;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, offset, end - offset, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	while (offset < end) {
+#if defined SEEK_DATA && defined SEEK_HOLE
+		/* ENXIO means only a hole is left; any other error means holes
+		 * can't be found here, so everything is treated as data */
+		data = lseek(fd, offset, SEEK_DATA);
+		if (data < 0) data = (errno == ENXIO) ? end : offset;
+		if (data > end) data = end;
+		hole = (data < end) ? lseek(fd, data, SEEK_HOLE) : end;
+		if (hole < 0 || hole > end) hole = end;
+#else
+		data = offset;
+		hole = end;
+#endif
+		if (data > offset) {
+			stats->holes++;
+			stats->hole_bytes += (uint64_t)(data - offset);
+			zero_run(&zt, (uint64_t)(data - offset));
+			hash_zeroes(ctx, (uint64_t)(data - offset));
+			offset = data;
+		}
+
+		while (offset < hole) {
+			/* Reads after the first one start on a zero block boundary */
+			want = bufsize - (size_t)((uint64_t)offset % JC_HASH_ZERO_BLOCK);
+			if ((uint64_t)(hole - offset) < want) want = (size_t)(hole - offset);
+			got = read_at(fd, buf, want, offset);
+			if (got < 0) {
+				err = -11;
+				goto done;
+			}
+			/* The file was truncated; hashing stops at EOF as usual */
+			if (got == 0) goto done;
+			jc_hash_update(ctx, buf, (size_t)got);
+			stats->data_bytes += (uint64_t)got;
+			scan_zero_blocks(&zt, buf, (size_t)got, offset);
+			if (nocache) drop_cached(fd, offset, offset + got);
+			offset += got;
+		}
+	}
+
+done:
+	free(buf);
+#if defined SEEK_DATA && defined SEEK_HOLE
+	if (saved >= 0) lseek(fd, saved, SEEK_SET);
+#endif
+	return err;
+}
+
+
+/* Sparse hashing of a range given as offset/length; uncached modes just
+ * drop what was read since hole-skipping reads aren't block aligned */
+static int hash_sparse_range(struct jc_hash_ctx *ctx, int fd, off_t offset, off_t length, struct jc_hash_zero_stats *stats, const int flags)
+{
+	struct stat st;
+	off_t end;
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+		return jc_hash_fd_update(ctx, fd, offset, length, (flags & ~JC_HASH_FILE_SPARSE) | JC_HASH_FILE_PREAD);
+	end = st.st_size;
+	if (length > 0 && offset + length < end) end = offset + length;
+	if (offset >= end) return 0;
+	return hash_fd_sparse(ctx, fd, offset, end, stats, flags & HASH_UNCACHED);
+}
+
+
+/* Sparse-aware version of jc_hash_fd_update(); the hash is the same, but
+ * holes are not read. Counts are added to *stats (which may be NULL), so
+ * clear it before the first call. Files that aren't regular files can't
+ * have holes and are read normally without adding to the counts. */
+extern int jc_hash_fd_sparse(struct jc_hash_ctx *ctx, int fd, off_t offset, off_t length, struct jc_hash_zero_stats *stats)
+{
+	if (unlikely(ctx == NULL || fd < 0 || offset < 0 || length < 0)) return -1;
+	return hash_sparse_range(ctx, fd, offset, length, stats, 0);
+}
+
+
+/* Add 'length' bytes of a file starting at 'offset' to a hash context
+ * A length of 0 hashes until EOF; hashing always stops at EOF */
+extern int jc_hash_fd_update(struct jc_hash_ctx *ctx, int fd, off_t offset, off_t length, int flags)
+{
+	struct stat st;
+	off_t end = -1;
+	int use_mmap = 0;
+#if defined O_DIRECT && !defined ON_WINDOWS
+	int i;
+#endif
+
+	if (unlikely(ctx == NULL || fd < 0 || offset < 0 || length < 0)) return -1;
+	if (flags & JC_HASH_FILE_SPARSE) return hash_sparse_range(ctx, fd, offset, length, NULL, flags);
+	if (length > 0) end = offset + length;
+
+	/* Regular files have a known size, so clamp the range to it */
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		if (end < 0 || end > st.st_size) end = st.st_size;
+		if (offset >= end) return 0;
+#ifndef ON_WINDOWS
+		/* Mapped pages stay cached, so the uncached modes always read */
+		if (!(flags & HASH_UNCACHED) && ((flags & JC_HASH_FILE_MMAP) || (!(flags & JC_HASH_FILE_PREAD) && (end - offset) >= HASH_MMAP_MIN)))
+			use_mmap = 1;
+#endif
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, offset, (end < 0) ? 0 : end - offset, POSIX_FADV_SEQUENTIAL);
+#endif
+
+#if defined O_DIRECT && !defined ON_WINDOWS
+	/* Without O_DIRECT support, read normally and drop the cached data */
+	if ((flags & JC_HASH_FILE_DIRECT) && end >= 0) {
+		i = hash_fd_direct(ctx, fd, &offset, end);
+		if (i != 1) return i;
+	}
+#endif
+#ifndef ON_WINDOWS
+	/* Fall back to reading if the file can't be mapped */
+	if (use_mmap && hash_fd_mmap(ctx, fd, &offset, end) == 0) return 0;
+#else
+	(void)use_mmap;
+#endif
+	return hash_fd_pread(ctx, fd, offset, end, flags & HASH_UNCACHED);
+}
+
+
+/* Hash a file once while reporting the running hash at each checkpoint
+ * Checkpoints are ascending file offsets (JC_HASH_EOF = end of file).
+ * Hashing resumes at ctx->length, so a context that already covers a
+ * prefix of the file (such as a partial hash) continues where it left
+ * off. Checkpoints past EOF get the hash of the whole file. A checkpoint
+ * before the data already hashed can't be reported and returns -1. */
+extern int jc_hash_fd_checkpoints(struct jc_hash_ctx *ctx, int fd, const off_t *checkpoints, jodyhash_t *hashes, const int count, int flags)
+{
+	off_t pos;
+	int i, err;
+
+	if (unlikely(ctx == NULL || checkpoints == NULL || hashes == NULL || count < 0)) return -1;
+
+	for (i = 0; i < count; i++) {
+		pos = (off_t)ctx->length;
+		if (checkpoints[i] == JC_HASH_EOF) {
+			err = jc_hash_fd_update(ctx, fd, pos, 0, flags);
+		} else if (checkpoints[i] > pos) {
+			err = jc_hash_fd_update(ctx, fd, pos, checkpoints[i] - pos, flags);
+		} else if (checkpoints[i] == pos) {
+			err = 0;
+		} else return -1;
+		if (err != 0) return err;
+		jc_hash_final(ctx, &hashes[i]);
+	}
+	return 0;
+}
+
+
+/* Hash part (or all) of an open file; see jc_hash_fd_update() */
+extern int jc_hash_fd(int fd, off_t offset, off_t length, int flags, jodyhash_t *hash)
+{
+	struct jc_hash_ctx ctx;
+	int i;
+
+	if (unlikely(hash == NULL)) return -1;
+	jc_hash_init(&ctx);
+	i = jc_hash_fd_update(&ctx, fd, offset, length, flags);
+	if (i != 0) return i;
+	jc_hash_final(&ctx, hash);
+	return 0;
+}
+
+
+/* Hash part (or all) of a file by name; see jc_hash_fd_update() */
+extern int jc_hash_file(const char *path, off_t offset, off_t length, int flags, jodyhash_t *hash)
+{
+	int fd, i;
+
+	if (unlikely(path == NULL || hash == NULL)) return -1;
+	fd = open(path, O_RDONLY | O_BINARY);
+	if (fd < 0) return -10;
+	i = jc_hash_fd(fd, offset, length, flags, hash);
+	close(fd);
+	return i;
+}
+
+
+/* This is for testing only */
+#ifdef JC_TEST
+int main(int argc, char **argv)
+{
+	jodyhash_t hash;
+	int i, err;
+
+	for (i = 1; i < argc; i++) {
+		err = jc_hash_file(argv[i], 0, 0, 0, &hash);
+		if (err != 0) printf("%s: error %d\n", argv[i], err);
+		else printf("%016llx  %s\n", (unsigned long long)hash, argv[i]);
+	}
+	return 0;
+}
+#endif
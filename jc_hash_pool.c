@@ -0,0 +1,170 @@
+/* Parallel file hashing
+ *
+ * Hashes a list of files on a group of worker threads. Each worker pulls
+ * the next job from a shared counter, so results land in input order
+ * no matter which thread finishes first. Jobs can also be run cached
+ * files first, with cold files read ahead while the cached ones hash.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "likely_unlikely.h"
+#include "libjodycode.h"
+#include "workers.h"
+
+#ifndef O_BINARY
+ #define O_BINARY 0
+#endif
+
+/* How much of a cold file to read ahead; normal readahead takes over
+ * once the file is being hashed */
+#define POOL_PREFETCH 16777216
+/* Most cold data to have in flight ahead of the workers */
+#define POOL_PREFETCH_BUDGET 33554432
+
+struct pool_state {
+	struct jc_hash_job *jobs;
+	size_t count;
+	size_t next;
+	int flags;
+	/* Resident-first order, and the running total of the amount to
+	 * prefetch for each position in it (prefetch[count] = total) */
+	const size_t *order;
+	const uint64_t *prefetch;
+	size_t prefetch_next;
+};
+
+
+/* Hash a single job; the path is only opened if no fd was supplied */
+static void hash_job(struct jc_hash_job *job, int flags)
+{
+	int fd = job->fd;
+
+	job->hash = 0;
+	if (fd < 0) {
+		if (unlikely(job->path == NULL)) {
+			job->status = -1;
+			return;
+		}
+		fd = open(job->path, O_RDONLY | O_BINARY);
+		if (fd < 0) {
+			job->status = -10;
+			return;
+		}
+	}
+	job->status = jc_hash_fd(fd, 0, job->length, flags, &job->hash);
+	if (job->fd < 0) close(fd);
+	return;
+}
+
+
+/* Start reading the beginning of a cold file so the I/O overlaps the
+ * hashing of the jobs before it */
+static void prefetch_job(const struct jc_hash_job *job)
+{
+#ifdef POSIX_FADV_WILLNEED
+	off_t len = POOL_PREFETCH;
+	int fd = job->fd;
+
+	if (job->length < 0) return;
+	if (fd < 0) {
+		if (job->path == NULL) return;
+		fd = open(job->path, O_RDONLY | O_BINARY);
+		if (fd < 0) return;
+	}
+	if (job->length > 0 && job->length < len) len = job->length;
+	posix_fadvise(fd, 0, len, POSIX_FADV_WILLNEED);
+	if (job->fd < 0) close(fd);
+#else
+	(void)job;
+#endif
+	return;
+}
+
+
+static void *pool_worker(void *arg)
+{
+	struct pool_state *ps = (struct pool_state *)arg;
+	size_t i, j;
+
+	while (1) {
+		i = JC_ATOMIC_NEXT(ps->next);
+		if (i >= ps->count) break;
+		if (ps->order == NULL) {
+			hash_job(&ps->jobs[i], ps->flags);
+			continue;
+		}
+		/* Keep up to POOL_PREFETCH_BUDGET of cold data requested past the
+		 * job being started; workers may overshoot it by a file each */
+		while (ps->prefetch != NULL) {
+			j = JC_ATOMIC_GET(ps->prefetch_next);
+			if (j >= ps->count) break;
+			if (j > i && ps->prefetch[j] - ps->prefetch[i] > POOL_PREFETCH_BUDGET) break;
+			j = JC_ATOMIC_NEXT(ps->prefetch_next);
+			if (j >= ps->count) break;
+			if (j > i && ps->prefetch[j + 1] != ps->prefetch[j]) prefetch_job(&ps->jobs[ps->order[j]]);
+		}
+		hash_job(&ps->jobs[ps->order[i]], ps->flags);
+	}
+	return NULL;
+}
+
+
+/* Hash many files on 'threads' threads (0 = one per CPU); the hash and
+ * status of each job are filled in. Returns the number of failed jobs.
+ * JC_HASH_FILE_RESIDENT_FIRST hashes the jobs in jc_hash_order_resident()
+ * order; if the order can't be worked out, input order is used. */
+extern int jc_hash_files(struct jc_hash_job *jobs, const size_t count, const unsigned int threads, const int flags)
+{
+	struct pool_state ps;
+	size_t *order = NULL;
+	uint64_t *uncached = NULL, *prefetch = NULL;
+	unsigned int workers;
+	size_t i;
+	int failed = 0;
+
+	if (unlikely(jobs == NULL && count != 0)) return -1;
+	if (count == 0) return 0;
+
+	/* Never start more threads than there are jobs */
+	workers = jc_worker_count(threads);
+	if (count < workers) workers = (unsigned int)count;
+
+	if (flags & JC_HASH_FILE_RESIDENT_FIRST) {
+		order = (size_t *)malloc(count * sizeof(size_t));
+		uncached = (uint64_t *)malloc(count * sizeof(uint64_t));
+		/* Prefetching would fill the cache the uncached modes keep clean */
+		if (!(flags & (JC_HASH_FILE_DIRECT | JC_HASH_FILE_NOCACHE)))
+			prefetch = (uint64_t *)malloc((count + 1) * sizeof(uint64_t));
+		if (order == NULL || uncached == NULL || jc_hash_order_resident(jobs, count, order, uncached) != 0) {
+			free(order);
+			free(prefetch);
+			order = NULL;
+			prefetch = NULL;
+		} else if (prefetch != NULL) {
+			prefetch[0] = 0;
+			for (i = 0; i < count; i++)
+				prefetch[i + 1] = prefetch[i] + ((uncached[order[i]] < POOL_PREFETCH) ? uncached[order[i]] : POOL_PREFETCH);
+		}
+		free(uncached);
+	}
+
+	ps.jobs = jobs;
+	ps.count = count;
+	ps.next = 0;
+	ps.flags = flags;
+	ps.order = order;
+	ps.prefetch = prefetch;
+	ps.prefetch_next = 0;
+	jc_run_workers(workers, pool_worker, &ps);
+	free(order);
+	free(prefetch);
+
+	for (i = 0; i < count; i++) if (jobs[i].status != 0) failed++;
+	return failed;
+}
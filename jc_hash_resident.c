@@ -0,0 +1,258 @@
+/* Page cache residency for file hashing
+ *
+ * Reports how much of a file is already in the page cache and orders a
+ * batch of hash jobs so that cached files (which cost almost nothing to
+ * hash) go first while the cold ones are read ahead in the background.
+ * Uses cachestat() on Linux 6.5+ and mincore() on a mapping otherwise.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef ON_WINDOWS
+ #include <sys/mman.h>
+#endif
+#ifdef __linux__
+ #include <sys/syscall.h>
+#endif
+#include "likely_unlikely.h"
+#include "libjodycode.h"
+#include "workers.h"
+
+#ifndef O_BINARY
+ #define O_BINARY 0
+#endif
+
+/* cachestat() is new enough that libc headers may not know it; it has the
+ * same number on every architecture except Alpha */
+#if defined __NR_cachestat
+ #define SYS_CACHESTAT __NR_cachestat
+#elif defined __linux__ && !defined __alpha__
+ #define SYS_CACHESTAT 451
+#endif
+
+/* Size of each window mapped for mincore() */
+#define RESIDENT_WINDOW 1073741824
+
+#ifdef SYS_CACHESTAT
+struct cachestat_range {
+	uint64_t off;
+	uint64_t len;
+};
+
+struct cachestat {
+	uint64_t nr_cache;
+	uint64_t nr_dirty;
+	uint64_t nr_writeback;
+	uint64_t nr_evicted;
+	uint64_t nr_recently_evicted;
+};
+
+/* Cleared the first time the kernel says it has no cachestat(); the
+ * ordering workers share it, so it is only accessed atomically */
+static int have_cachestat = 1;
+#endif
+
+struct order_state {
+	const struct jc_hash_job *jobs;
+	uint64_t *uncached;
+	size_t count;
+	size_t next;
+};
+
+struct order_key {
+	uint64_t uncached;
+	size_t index;
+};
+
+
+#ifndef ON_WINDOWS
+/* Count resident pages in [start, end) with mincore(); start must be page
+ * aligned. Returns 1 if the file can't be mapped. */
+static int resident_mincore(int fd, off_t start, const off_t end, const long pagesize, uint64_t *pages)
+{
+	unsigned char *vec = NULL;
+	void *map;
+	size_t maplen, n, vecsize = 0;
+
+	*pages = 0;
+	for (; start < end; start += (off_t)maplen) {
+		maplen = RESIDENT_WINDOW;
+		if ((uint64_t)(end - start) < maplen) maplen = (size_t)(end - start);
+		n = (maplen + (size_t)pagesize - 1) / (size_t)pagesize;
+		if (vec == NULL) {
+			vecsize = n;
+			vec = (unsigned char *)malloc(vecsize);
+			if (unlikely(vec == NULL)) return 1;
+		}
+		map = mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd, start);
+		if (map == MAP_FAILED) {
+			free(vec);
+			return 1;
+		}
+		/* mincore() only looks at the page cache; nothing is read */
+		if (mincore(map, maplen, (void *)vec) != 0) {
+			munmap(map, maplen);
+			free(vec);
+			return 1;
+		}
+		munmap(map, maplen);
+		for (size_t i = 0; i < n && i < vecsize; i++) *pages += vec[i] & 1;
+	}
+	free(vec);
+	return 0;
+}
+#endif /* ON_WINDOWS */
+
+
+/* Find how many bytes of 'length' bytes (0 = to EOF) of a regular file
+ * starting at 'offset' are in the page cache. *total gets the size of the
+ * range after clamping it to the file size. Residency is counted in whole
+ * pages, so *resident is an estimate for ranges that aren't page aligned.
+ * Returns 1 if this can't be found out for this file or system. */
+extern int jc_file_resident(int fd, off_t offset, off_t length, uint64_t *resident, uint64_t *total)
+{
+#ifndef ON_WINDOWS
+	static long cached_pagesize = 0;
+	long pagesize;
+	struct stat st;
+	uint64_t pages = 0;
+	off_t start, end;
+#ifdef SYS_CACHESTAT
+	struct cachestat_range range;
+	struct cachestat cs;
+#endif
+#endif
+
+	if (unlikely(fd < 0 || offset < 0 || length < 0 || resident == NULL || total == NULL)) return -1;
+	*resident = 0;
+	*total = 0;
+#ifdef ON_WINDOWS
+	return 1;
+#else
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return 1;
+	end = st.st_size;
+	if (length > 0 && offset + length < end) end = offset + length;
+	if (offset >= end) return 0;
+	*total = (uint64_t)(end - offset);
+
+	/* Called from the ordering workers, so the cached value is atomic */
+	pagesize = JC_ATOMIC_GET(cached_pagesize);
+	if (pagesize == 0) {
+		pagesize = sysconf(_SC_PAGESIZE);
+		JC_ATOMIC_SET(cached_pagesize, pagesize);
+	}
+	if (pagesize <= 0) return 1;
+	start = offset - offset % pagesize;
+
+#ifdef SYS_CACHESTAT
+	if (JC_ATOMIC_GET(have_cachestat)) {
+		range.off = (uint64_t)start;
+		range.len = (uint64_t)(end - start);
+		if (syscall(SYS_CACHESTAT, fd, &range, &cs, 0) == 0) {
+			pages = cs.nr_cache;
+			goto done;
+		}
+		if (errno == ENOSYS) JC_ATOMIC_SET(have_cachestat, 0);
+	}
+#endif
+	if (resident_mincore(fd, start, end, pagesize, &pages) != 0) return 1;
+#ifdef SYS_CACHESTAT
+done:
+#endif
+	*resident = pages * (uint64_t)pagesize;
+	if (*resident > *total) *resident = *total;
+	return 0;
+#endif /* ON_WINDOWS */
+}
+
+
+/* Bytes of a job that would have to come from disk; jobs that can't be
+ * checked count as fully uncached, and jobs that will fail count as 0 */
+static uint64_t job_uncached(const struct jc_hash_job *job)
+{
+	uint64_t resident, total;
+	int fd = job->fd, i;
+
+	if (fd < 0) {
+		if (job->path == NULL) return 0;
+		fd = open(job->path, O_RDONLY | O_BINARY);
+		if (fd < 0) return 0;
+	}
+	i = jc_file_resident(fd, 0, job->length, &resident, &total);
+	if (job->fd < 0) close(fd);
+	if (i != 0) return UINT64_MAX;
+	return total - resident;
+}
+
+
+static void *order_worker(void *arg)
+{
+	struct order_state *os = (struct order_state *)arg;
+	size_t i;
+
+	while (1) {
+		i = JC_ATOMIC_NEXT(os->next);
+		if (i >= os->count) break;
+		os->uncached[i] = job_uncached(&os->jobs[i]);
+	}
+	return NULL;
+}
+
+
+static int order_cmp(const void *a, const void *b)
+{
+	const struct order_key *ka = (const struct order_key *)a;
+	const struct order_key *kb = (const struct order_key *)b;
+
+	if (ka->uncached != kb->uncached) return (ka->uncached < kb->uncached) ? -1 : 1;
+	/* Keep input order for ties */
+	return (ka->index < kb->index) ? -1 : (ka->index > kb->index);
+}
+
+
+/* Put job indexes in order[] so the jobs needing the least disk I/O come
+ * first; cached files go first and files that can't be checked go last.
+ * If 'uncached' isn't NULL it gets the uncached byte count of each job
+ * (UINT64_MAX = unknown), indexed like jobs[]. */
+extern int jc_hash_order_resident(const struct jc_hash_job *jobs, const size_t count, size_t *order, uint64_t *uncached)
+{
+	struct order_state os;
+	struct order_key *keys;
+	unsigned int threads;
+
+	if (unlikely((jobs == NULL || order == NULL) && count != 0)) return -1;
+	if (count == 0) return 0;
+
+	keys = (struct order_key *)malloc(count * sizeof(struct order_key));
+	os.uncached = uncached ? uncached : (uint64_t *)malloc(count * sizeof(uint64_t));
+	if (unlikely(keys == NULL || os.uncached == NULL)) {
+		free(keys);
+		if (uncached == NULL) free(os.uncached);
+		return -12;
+	}
+
+	/* Checking is mostly open() and a system call, so spread it out */
+	os.jobs = jobs;
+	os.count = count;
+	os.next = 0;
+	threads = jc_worker_count(0);
+	jc_run_workers((count < threads) ? (unsigned int)count : threads, order_worker, &os);
+
+	for (size_t i = 0; i < count; i++) {
+		keys[i].uncached = os.uncached[i];
+		keys[i].index = i;
+	}
+	qsort(keys, count, sizeof(struct order_key), order_cmp);
+	for (size_t i = 0; i < count; i++) order[i] = keys[i].index;
+
+	free(keys);
+	if (uncached == NULL) free(os.uncached);
+	return 0;
+}
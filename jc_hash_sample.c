@@ -0,0 +1,398 @@
+/* Sampled "quick fingerprint" hashing
+ *
+ * Hashes the first block, the last block and a few evenly spaced blocks
+ * in between, plus the file size, so files that can't be duplicates are
+ * told apart after reading a few hundred KB no matter how big they are.
+ * All sample reads are issued together: the single-file version asks
+ * the kernel to read ahead every block before reading the first one, and
+ * the many-file version keeps the reads of many files in flight at once
+ * with io_uring when it is available.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "likely_unlikely.h"
+#include "jody_hash.h"
+#include "libjodycode.h"
+#include "jc_uring.h"
+
+/* Sample offsets are aligned to this (except the last block) */
+#define SAMPLE_ALIGN       4096
+/* Layout limits; a sample never needs more than 64 reads */
+#define SAMPLE_BLOCKS_MAX  62
+#define SAMPLE_RANGES_MAX  (SAMPLE_BLOCKS_MAX + 2)
+#define SAMPLE_BLOCK_MAX   1048576
+
+#ifndef O_BINARY
+ #define O_BINARY 0
+#endif
+
+/* The byte ranges that make up one file's sample */
+struct sample_plan {
+	off_t size;
+	unsigned int count;
+	size_t total;
+	off_t off[SAMPLE_RANGES_MAX];
+	size_t len[SAMPLE_RANGES_MAX];
+};
+
+
+/* Work out which ranges of a file to hash (format JODY_HASH_SAMPLE_VERSION)
+ * Small files are hashed completely; otherwise the first block, 'blocks'
+ * blocks at evenly spaced aligned offsets and the last block are used,
+ * with any overlaps merged so no byte is hashed twice */
+static void sample_plan(struct sample_plan *p, const off_t size, const unsigned int blocks, const size_t bs)
+{
+	off_t o, stride;
+	unsigned int n = 0;
+
+	p->size = size;
+	p->count = 0;
+	p->total = 0;
+	if (size == 0) return;
+	if ((uint64_t)size <= (uint64_t)(blocks + 2) * bs) {
+		p->off[0] = 0;
+		p->len[0] = (size_t)size;
+		p->count = 1;
+		p->total = (size_t)size;
+		return;
+	}
+
+	stride = size / (off_t)(blocks + 1);
+	for (unsigned int i = 0; i <= blocks + 1; i++) {
+		if (i == 0) o = 0;
+		else if (i == blocks + 1) o = size - (off_t)bs;
+		else o = (stride * (off_t)i) & ~((off_t)SAMPLE_ALIGN - 1);
+		if (n > 0 && o <= p->off[n - 1] + (off_t)p->len[n - 1]) {
+			p->len[n - 1] = (size_t)(o + (off_t)bs - p->off[n - 1]);
+			continue;
+		}
+		p->off[n] = o;
+		p->len[n] = bs;
+		n++;
+	}
+	p->count = n;
+	for (unsigned int i = 0; i < n; i++) p->total += p->len[i];
+	return;
+}
+
+
+/* Hash the sampled bytes (stored back to back in buf) and the size */
+static void sample_final(const struct sample_plan *p, const unsigned char *buf, jodyhash_t *hash)
+{
+	struct jc_hash_ctx ctx;
+	unsigned char le[8];
+	uint64_t size = (uint64_t)p->size;
+
+	for (int i = 0; i < 8; i++) le[i] = (unsigned char)(size >> (i * 8));
+	jc_hash_init(&ctx);
+	jc_hash_update(&ctx, buf, p->total);
+	jc_hash_update(&ctx, le, 8);
+	jc_hash_final(&ctx, hash);
+	return;
+}
+
+
+/* Fill in the default layout and check the caller's layout */
+static int sample_layout(unsigned int *blocks, size_t *block_size)
+{
+	if (*blocks == 0) *blocks = JC_HASH_SAMPLE_BLOCKS;
+	if (*block_size == 0) *block_size = JC_HASH_SAMPLE_BLOCK_SIZE;
+	if (*blocks > SAMPLE_BLOCKS_MAX || *block_size > SAMPLE_BLOCK_MAX) return -1;
+	return 0;
+}
+
+
+static ssize_t read_full(int fd, unsigned char *buf, size_t count, off_t offset)
+{
+	size_t done = 0;
+	ssize_t i;
+
+	while (done < count) {
+#ifdef ON_WINDOWS
+		if (lseek(fd, offset + (off_t)done, SEEK_SET) == -1) return -1;
+		i = read(fd, buf + done, (unsigned int)(count - done));
+#else
+		i = pread(fd, buf + done, count - done, offset + (off_t)done);
+#endif
+		if (i < 0 && errno == EINTR) continue;
+		if (i < 0) return -1;
+		if (i == 0) break;
+		done += (size_t)i;
+	}
+	return (ssize_t)done;
+}
+
+
+/* Quick fingerprint of a file: 'blocks' evenly spaced blocks of
+ * 'block_size' bytes plus the first and last blocks and the size
+ * (0 = the defaults). 'size' of 0 uses the file's current size. Files
+ * only match if they were fingerprinted with the same layout. */
+extern int jc_hash_sample(int fd, off_t size, unsigned int blocks, size_t block_size, jodyhash_t *hash)
+{
+	struct sample_plan p;
+	struct stat st;
+	unsigned char *buf, *pos;
+	ssize_t got;
+
+	if (unlikely(fd < 0 || hash == NULL || size < 0)) return -1;
+	if (sample_layout(&blocks, &block_size) != 0) return -1;
+	if (size == 0) {
+		if (fstat(fd, &st) != 0) return -11;
+		size = st.st_size;
+	}
+	sample_plan(&p, size, blocks, block_size);
+	buf = (unsigned char *)malloc(p.total ? p.total : 1);
+	if (unlikely(buf == NULL)) return -12;
+
+#ifdef POSIX_FADV_WILLNEED
+	/* Start reading every block now so the reads below overlap */
+	if (p.count > 1) for (unsigned int i = 0; i < p.count; i++) posix_fadvise(fd, p.off[i], (off_t)p.len[i], POSIX_FADV_WILLNEED);
+#endif
+	pos = buf;
+	for (unsigned int i = 0; i < p.count; i++) {
+		got = read_full(fd, pos, p.len[i], p.off[i]);
+		if (got < 0 || (size_t)got != p.len[i]) {
+			free(buf);
+			return got < 0 ? -11 : -14;
+		}
+		pos += p.len[i];
+	}
+	sample_final(&p, buf, hash);
+	free(buf);
+	return 0;
+}
+
+
+static int sample_job_sync(struct jc_hash_job *job, const unsigned int blocks, const size_t block_size)
+{
+	int fd = job->fd, i;
+
+	if (fd < 0) {
+		if (unlikely(job->path == NULL)) return -1;
+		fd = open(job->path, O_RDONLY | O_BINARY);
+		if (fd < 0) return -10;
+	}
+	i = jc_hash_sample(fd, job->length, blocks, block_size, &job->hash);
+	if (fd != job->fd) close(fd);
+	return i;
+}
+
+
+#ifdef JC_URING
+#include <sys/uio.h>
+
+#define SAMPLE_DEPTH_DEFAULT 64
+#define SAMPLE_DEPTH_MAX     1024
+
+/* A file whose sample reads are in flight */
+struct sslot {
+	struct jc_hash_job *job;
+	struct sample_plan plan;
+	struct iovec iov[SAMPLE_RANGES_MAX];
+	unsigned char *buf;
+	int fd;
+	int status;
+	unsigned int pending;
+};
+
+
+static void sslot_finish(struct sslot *s)
+{
+	if (s->status == 0) sample_final(&s->plan, s->buf, &s->job->hash);
+	s->job->status = s->status;
+	if (s->fd != s->job->fd) close(s->fd);
+	s->job = NULL;
+	return;
+}
+
+
+static void sslot_queue(struct jc_uring *ring, struct sslot *s, const unsigned int slot, const unsigned int range)
+{
+	struct io_uring_sqe *sqe = jc_uring_get_sqe(ring);
+
+	/* The ring always has room for every range of every slot */
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = s->fd;
+	sqe->off = (uint64_t)s->plan.off[range];
+	sqe->addr = (uint64_t)(uintptr_t)&s->iov[range];
+	sqe->len = 1;
+	sqe->user_data = (uint64_t)slot * SAMPLE_RANGES_MAX + range;
+	return;
+}
+
+
+/* Open a job's file and queue all of its sample reads; returns 0 if the
+ * job was finished on the spot */
+static int sslot_start(struct jc_uring *ring, struct sslot *s, const unsigned int slot, struct jc_hash_job *job,
+		const unsigned int blocks, const size_t block_size)
+{
+	struct stat st;
+	unsigned char *pos;
+
+	job->hash = 0;
+	s->job = job;
+	s->fd = job->fd;
+	s->status = 0;
+	s->pending = 0;
+	if (s->fd < 0) {
+		if (unlikely(job->path == NULL)) s->status = -1;
+		else if ((s->fd = open(job->path, O_RDONLY | O_BINARY)) < 0) s->status = -10;
+		if (s->status != 0) {
+			job->status = s->status;
+			s->job = NULL;
+			return 0;
+		}
+	}
+	if (job->length == 0 && fstat(s->fd, &st) != 0) s->status = -11;
+	if (s->status == 0) sample_plan(&s->plan, job->length ? job->length : st.st_size, blocks, block_size);
+	if (s->status != 0 || s->plan.count == 0) {
+		sslot_finish(s);
+		return 0;
+	}
+
+	pos = s->buf;
+	for (unsigned int i = 0; i < s->plan.count; i++) {
+		s->iov[i].iov_base = pos;
+		s->iov[i].iov_len = s->plan.len[i];
+		pos += s->plan.len[i];
+		sslot_queue(ring, s, slot, i);
+		s->pending++;
+	}
+	return 1;
+}
+
+
+/* A read completed; short reads are finished with another read and
+ * interrupted ones are simply queued again */
+static void sslot_complete(struct jc_uring *ring, struct sslot *s, const unsigned int slot, const unsigned int range, const int res)
+{
+	struct iovec *iov = &s->iov[range];
+
+	if (res == -EINTR || res == -EAGAIN) {
+		sslot_queue(ring, s, slot, range);
+		return;
+	}
+	s->pending--;
+	if (s->status != 0) return;
+	if (res < 0) s->status = -11;
+	else if (res == 0) s->status = -14;
+	else if ((size_t)res < iov->iov_len) {
+		iov->iov_base = (unsigned char *)iov->iov_base + res;
+		iov->iov_len -= (size_t)res;
+		s->plan.off[range] += res;
+		sslot_queue(ring, s, slot, range);
+		s->pending++;
+	}
+	return;
+}
+#endif /* JC_URING */
+
+
+/* Fingerprint many files; each job's length is the size to use (0 = the
+ * current size). With io_uring, the reads of up to 'depth' blocks (0 =
+ * default) from many files are in flight together. Returns the number
+ * of failed jobs. */
+extern int jc_hash_sample_files(struct jc_hash_job *jobs, const size_t count, unsigned int blocks, size_t block_size, unsigned int depth)
+{
+#ifdef JC_URING
+	struct jc_uring ring;
+	struct io_uring_cqe *cqe;
+	struct sslot *slots;
+	unsigned char *data;
+	unsigned int nslots, active = 0, i, slot, range;
+	size_t next = 0;
+	int err, res;
+#endif
+	size_t first = 0;
+	int failed = 0;
+
+	if (unlikely(jobs == NULL && count != 0)) return -1;
+	if (sample_layout(&blocks, &block_size) != 0) return -1;
+	if (count == 0) return 0;
+
+#ifdef JC_URING
+	if (depth == 0) depth = SAMPLE_DEPTH_DEFAULT;
+	if (depth > SAMPLE_DEPTH_MAX) depth = SAMPLE_DEPTH_MAX;
+	nslots = depth / (blocks + 2);
+	if (nslots == 0) nslots = 1;
+	if (jc_uring_init(&ring, nslots * SAMPLE_RANGES_MAX) != 0) goto fallback;
+	slots = (struct sslot *)calloc(nslots, sizeof(struct sslot));
+	data = (unsigned char *)malloc((size_t)nslots * (blocks + 2) * block_size);
+	if (unlikely(slots == NULL || data == NULL)) {
+		free(slots);
+		free(data);
+		jc_uring_exit(&ring);
+		goto fallback;
+	}
+	for (i = 0; i < nslots; i++) slots[i].buf = data + (size_t)i * (blocks + 2) * block_size;
+
+	while (next < count || active > 0) {
+		for (i = 0; i < nslots && next < count; i++) {
+			if (slots[i].job != NULL) continue;
+			while (next < count && sslot_start(&ring, &slots[i], i, &jobs[next], blocks, block_size) == 0) next++;
+			if (next < count) {
+				next++;
+				active++;
+			}
+		}
+		if (active == 0) continue;
+
+		err = jc_uring_submit(&ring, 1);
+		if (err != 0 && err != -EAGAIN && err != -EBUSY) goto abort;
+		while ((cqe = jc_uring_peek_cqe(&ring)) != NULL) {
+			slot = (unsigned int)(cqe->user_data / SAMPLE_RANGES_MAX);
+			range = (unsigned int)(cqe->user_data % SAMPLE_RANGES_MAX);
+			res = cqe->res;
+			jc_uring_cqe_seen(&ring);
+			sslot_complete(&ring, &slots[slot], slot, range, res);
+			if (slots[slot].pending == 0) {
+				sslot_finish(&slots[slot]);
+				active--;
+			}
+		}
+	}
+
+	jc_uring_exit(&ring);
+	free(slots);
+	free(data);
+	for (size_t j = 0; j < count; j++) if (jobs[j].status != 0) failed++;
+	return failed;
+
+abort:
+	/* Reads already running finish even after the ring is closed, so
+	 * they are waited for before their buffers and iovecs go away (or
+	 * those are leaked if that isn't possible). Files being read fail and
+	 * the rest are fingerprinted synchronously. */
+	err = jc_uring_drain(&ring);
+	jc_uring_exit(&ring);
+	for (i = 0; i < nslots; i++) {
+		if (slots[i].job == NULL) continue;
+		slots[i].status = -11;
+		sslot_finish(&slots[i]);
+	}
+	if (err == 0) {
+		free(slots);
+		free(data);
+	}
+	for (size_t j = 0; j < next; j++) if (jobs[j].status != 0) failed++;
+	first = next;
+
+fallback:
+#else
+	(void)depth;
+#endif /* JC_URING */
+	for (size_t j = first; j < count; j++) {
+		jobs[j].status = sample_job_sync(&jobs[j], blocks, block_size);
+		if (jobs[j].status != 0) failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,263 @@
+/* Shared-memory hash cache for concurrent processes
+ *
+ * A fixed-size, lock-free open addressing table in a shared file (put it
+ * in /dev/shm for a pure memory segment) that maps (dev, ino, size,
+ * mtime) to a jody_hash. Any number of processes can insert and look up
+ * at the same time, so scanners running side by side can share hashing
+ * work without a daemon. Entries are never removed or moved; a changed
+ * file simply gets a new entry because its size or mtime differs.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#ifndef ON_WINDOWS
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "likely_unlikely.h"
+#include "jody_hash.h"
+#include "libjodycode.h"
+
+/* Table layout (native byte order; the table never leaves this machine):
+ * Header (64 bytes): magic "JHSHM\0\0\0", format (32-bit), JODY_HASH_VERSION
+ * (32-bit), number of slots (64-bit), ready flag (32-bit), then zeroes.
+ * Each 64-byte slot is a struct shm_slot. A slot is claimed by changing
+ * its tag from 0 with a compare-and-swap; the claiming process fills in
+ * the key and hash and then sets 'ready'. Readers ignore slots that are
+ * not ready yet, so a half-written entry is never used. */
+#define SHM_FORMAT 1
+#define SHM_HEADER 64
+#define SHM_DEFAULT_SLOTS 1048576
+/* How long to wait for another process to finish creating the table */
+#define SHM_WAIT_MS 2000
+
+static const unsigned char shm_magic[8] = { 'J', 'H', 'S', 'H', 'M', 0, 0, 0 };
+
+struct shm_header {
+	unsigned char magic[8];
+	uint32_t format;
+	uint32_t hash_version;
+	uint64_t slots;
+	uint32_t ready;
+	uint32_t pad[7];
+};
+
+struct shm_slot {
+	uint64_t tag;
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime;
+	uint32_t mtime_nsec;
+	uint32_t ready;
+	jodyhash_t hash;
+	uint64_t pad;
+};
+
+struct jc_hash_shm {
+	struct shm_header *header;
+	struct shm_slot *slots;
+	uint64_t mask;
+	size_t map_len;
+};
+
+
+/* Hash of the whole key; never zero because zero marks an empty slot */
+static uint64_t key_tag(const struct jc_hash_cache_entry *key)
+{
+	uint64_t k[5];
+	jodyhash_t hash = 0;
+
+	k[0] = key->dev;
+	k[1] = key->ino;
+	k[2] = key->size;
+	k[3] = (uint64_t)key->mtime;
+	k[4] = key->mtime_nsec;
+	jody_block_hash(k, &hash, sizeof(k));
+	return hash ? (uint64_t)hash : 1;
+}
+
+
+static int key_match(const struct shm_slot *s, const struct jc_hash_cache_entry *key)
+{
+	return s->dev == key->dev && s->ino == key->ino && s->size == key->size
+		&& s->mtime == key->mtime && s->mtime_nsec == key->mtime_nsec;
+}
+
+
+static void wait_ms(long ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000;
+	nanosleep(&ts, NULL);
+	return;
+}
+
+
+/* Open a shared table, creating it with room for 'slots' entries (rounded
+ * up to a power of two; 0 = default) if it doesn't exist yet. The size of
+ * an existing table is never changed. */
+extern int jc_hash_shm_open(const char *path, uint64_t slots, struct jc_hash_shm **shm)
+{
+	struct jc_hash_shm *c;
+	struct shm_header *h;
+	struct stat st;
+	uint64_t n = 1;
+	void *map;
+	int fd, creator = 1, waited = 0;
+
+	if (unlikely(path == NULL || shm == NULL)) return -1;
+	*shm = NULL;
+	if (slots == 0) slots = SHM_DEFAULT_SLOTS;
+	while (n < slots && n < (SIZE_MAX - SHM_HEADER) / sizeof(struct shm_slot) / 2) n *= 2;
+	slots = n;
+
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0666);
+	if (fd < 0 && errno == EEXIST) {
+		creator = 0;
+		fd = open(path, O_RDWR);
+	}
+	if (fd < 0) return -10;
+
+	if (creator) {
+		if (ftruncate(fd, (off_t)(SHM_HEADER + slots * sizeof(struct shm_slot))) != 0) goto error_remove;
+	} else {
+		/* The creator may not have set the size yet */
+		while (1) {
+			if (fstat(fd, &st) != 0) goto error_bad;
+			if (st.st_size != 0 || waited >= SHM_WAIT_MS) break;
+			wait_ms(1);
+			waited++;
+		}
+		if (st.st_size < SHM_HEADER || (uint64_t)st.st_size > SIZE_MAX) goto error_bad;
+		slots = ((uint64_t)st.st_size - SHM_HEADER) / sizeof(struct shm_slot);
+	}
+
+	map = mmap(NULL, (size_t)(SHM_HEADER + slots * sizeof(struct shm_slot)), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		if (creator) goto error_remove;
+		close(fd);
+		return -12;
+	}
+	close(fd);
+	h = (struct shm_header *)map;
+
+	if (creator) {
+		memcpy(h->magic, shm_magic, 8);
+		h->format = SHM_FORMAT;
+		h->hash_version = JODY_HASH_VERSION;
+		h->slots = slots;
+		__atomic_store_n(&h->ready, 1, __ATOMIC_RELEASE);
+	} else {
+		while (__atomic_load_n(&h->ready, __ATOMIC_ACQUIRE) == 0 && waited < SHM_WAIT_MS) {
+			wait_ms(1);
+			waited++;
+		}
+		if (h->ready == 0 || memcmp(h->magic, shm_magic, 8) != 0 || h->format != SHM_FORMAT
+				|| h->hash_version != JODY_HASH_VERSION || h->slots != slots
+				|| slots == 0 || (slots & (slots - 1)) != 0) {
+			munmap(map, (size_t)(SHM_HEADER + slots * sizeof(struct shm_slot)));
+			return -17;
+		}
+	}
+
+	c = (struct jc_hash_shm *)malloc(sizeof(struct jc_hash_shm));
+	if (unlikely(c == NULL)) {
+		munmap(map, (size_t)(SHM_HEADER + slots * sizeof(struct shm_slot)));
+		return -12;
+	}
+	c->header = h;
+	c->slots = (struct shm_slot *)(void *)((unsigned char *)map + SHM_HEADER);
+	c->mask = slots - 1;
+	c->map_len = (size_t)(SHM_HEADER + slots * sizeof(struct shm_slot));
+	*shm = c;
+	return 0;
+
+error_remove:
+	close(fd);
+	unlink(path);
+	return -10;
+error_bad:
+	close(fd);
+	return -17;
+}
+
+
+/* Detach from a shared table; the table itself stays until it is deleted */
+extern void jc_hash_shm_close(struct jc_hash_shm *shm)
+{
+	if (shm == NULL) return;
+	munmap(shm->header, shm->map_len);
+	free(shm);
+	return;
+}
+
+
+/* Look up a file (key fields of 'key' only); returns 0 and sets *hash on
+ * a hit or 1 on a miss */
+extern int jc_hash_shm_get(struct jc_hash_shm *shm, const struct jc_hash_cache_entry *key, jodyhash_t *hash)
+{
+	struct shm_slot *s;
+	uint64_t tag, cur, slot;
+
+	if (unlikely(shm == NULL || key == NULL || hash == NULL)) return -1;
+	tag = key_tag(key);
+	slot = tag & shm->mask;
+	for (uint64_t n = 0; n <= shm->mask; n++) {
+		s = &shm->slots[slot];
+		cur = __atomic_load_n(&s->tag, __ATOMIC_ACQUIRE);
+		if (cur == 0) return 1;
+		if (cur == tag && __atomic_load_n(&s->ready, __ATOMIC_ACQUIRE) != 0 && key_match(s, key)) {
+			*hash = s->hash;
+			return 0;
+		}
+		slot = (slot + 1) & shm->mask;
+	}
+	return 1;
+}
+
+
+/* Add a file's hash; adding a file that is already there does nothing.
+ * Returns -16 if the table is full. */
+extern int jc_hash_shm_put(struct jc_hash_shm *shm, const struct jc_hash_cache_entry *key, const jodyhash_t hash)
+{
+	struct shm_slot *s;
+	uint64_t tag, cur, slot;
+
+	if (unlikely(shm == NULL || key == NULL)) return -1;
+	tag = key_tag(key);
+	slot = tag & shm->mask;
+	for (uint64_t n = 0; n <= shm->mask; n++) {
+		s = &shm->slots[slot];
+		cur = __atomic_load_n(&s->tag, __ATOMIC_ACQUIRE);
+		if (cur == 0) {
+			if (__atomic_compare_exchange_n(&s->tag, &cur, tag, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				s->dev = key->dev;
+				s->ino = key->ino;
+				s->size = key->size;
+				s->mtime = key->mtime;
+				s->mtime_nsec = key->mtime_nsec;
+				s->hash = hash;
+				__atomic_store_n(&s->ready, 1, __ATOMIC_RELEASE);
+				return 0;
+			}
+			/* Lost the race; cur now holds the winner's tag */
+		}
+		/* Another process may be writing this same key right now */
+		if (cur == tag && (__atomic_load_n(&s->ready, __ATOMIC_ACQUIRE) == 0 || key_match(s, key))) return 0;
+		slot = (slot + 1) & shm->mask;
+	}
+	return -16;
+}
+
+#endif /* ON_WINDOWS */
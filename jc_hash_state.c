@@ -0,0 +1,135 @@
+/* Saving and restoring jody_hash streaming state
+ *
+ * A saved state lets a program hash only the data appended to a file
+ * since the last time it was hashed. The state is a fixed-size,
+ * byte-order independent blob that is tied to the jody_hash version.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "likely_unlikely.h"
+#include "libjodycode.h"
+
+/* Saved state layout (all integers little-endian):
+ *  0  magic "JHST"
+ *  4  state format version
+ *  5  JODY_HASH_VERSION
+ *  6  JODY_HASH_WIDTH
+ *  7  number of bytes in the partial tail word
+ *  8  total length hashed (64-bit)
+ * 16  running hash (64-bit)
+ * 24  bytes of the partial tail word in the order they were hashed
+ *     (the tail is data, not a number); unused bytes are zero
+ * 32  length of the check window (32-bit)
+ * 36  reserved, must be zero
+ * 40  hash of the check window (64-bit) */
+#define STATE_FORMAT 1
+#define CHECK_WINDOW 4096
+
+static const unsigned char state_magic[4] = { 'J', 'H', 'S', 'T' };
+
+
+static void put_le(unsigned char *p, uint64_t val, unsigned int bytes)
+{
+	for (unsigned int i = 0; i < bytes; i++) p[i] = (unsigned char)(val >> (i * 8));
+	return;
+}
+
+static uint64_t get_le(const unsigned char *p, unsigned int bytes)
+{
+	uint64_t val = 0;
+	while (bytes > 0) {
+		bytes--;
+		val = (val << 8) | p[bytes];
+	}
+	return val;
+}
+
+
+/* Save a hash context to a JC_HASH_STATE_SIZE byte buffer
+ * If fd is a valid file descriptor for the hashed file, a hash of the
+ * last few KiB of the hashed data is stored for jc_hash_fd_resume() */
+extern int jc_hash_state_save(const struct jc_hash_ctx *ctx, int fd, unsigned char *state)
+{
+	jodyhash_t check = 0;
+	uint64_t check_len = 0;
+	int i;
+
+	if (unlikely(ctx == NULL || state == NULL)) return -1;
+
+	if (fd >= 0 && ctx->length > 0) {
+		check_len = (ctx->length < CHECK_WINDOW) ? ctx->length : CHECK_WINDOW;
+		i = jc_hash_fd(fd, (off_t)(ctx->length - check_len), (off_t)check_len, JC_HASH_FILE_PREAD, &check);
+		if (i != 0) return i;
+	}
+
+	memset(state, 0, JC_HASH_STATE_SIZE);
+	memcpy(state, state_magic, 4);
+	state[4] = STATE_FORMAT;
+	state[5] = JODY_HASH_VERSION;
+	state[6] = JODY_HASH_WIDTH;
+	state[7] = (unsigned char)ctx->tail_len;
+	put_le(state + 8, ctx->length, 8);
+	put_le(state + 16, ctx->hash, 8);
+	memcpy(state + 24, &ctx->tail, ctx->tail_len);
+	put_le(state + 32, check_len, 4);
+	put_le(state + 40, check, 8);
+	return 0;
+}
+
+
+/* Load a saved hash context; returns -13 if the state is unusable */
+extern int jc_hash_state_load(struct jc_hash_ctx *ctx, const unsigned char *state)
+{
+	if (unlikely(ctx == NULL || state == NULL)) return -1;
+
+	/* Only whole words are hashed before the end, so the tail is always
+	 * the length modulo the word size */
+	if (memcmp(state, state_magic, 4) != 0 || state[4] != STATE_FORMAT
+			|| state[5] != JODY_HASH_VERSION || state[6] != JODY_HASH_WIDTH
+			|| state[7] != (get_le(state + 8, 8) & (sizeof(jodyhash_t) - 1))
+			|| get_le(state + 32, 4) > CHECK_WINDOW || get_le(state + 36, 4) != 0)
+		return -13;
+	for (unsigned int i = state[7]; i < sizeof(jodyhash_t); i++)
+		if (state[24 + i] != 0) return -13;
+
+	jc_hash_init(ctx);
+	ctx->tail_len = state[7];
+	ctx->length = get_le(state + 8, 8);
+	ctx->hash = get_le(state + 16, 8);
+	memcpy(&ctx->tail, state + 24, ctx->tail_len);
+	return 0;
+}
+
+
+/* Restore a saved context and hash whatever was appended to the file
+ * since the state was saved. Returns -14 if the file is now shorter than
+ * the saved length or the check window no longer matches. */
+extern int jc_hash_fd_resume(struct jc_hash_ctx *ctx, int fd, const unsigned char *state, int flags)
+{
+	struct stat st;
+	jodyhash_t check;
+	uint64_t check_len;
+	int i;
+
+	if (unlikely(ctx == NULL || state == NULL || fd < 0)) return -1;
+	i = jc_hash_state_load(ctx, state);
+	if (i != 0) return i;
+
+	if (fstat(fd, &st) != 0) return -11;
+	if ((uint64_t)st.st_size < ctx->length) return -14;
+
+	check_len = get_le(state + 32, 4);
+	if (check_len != 0) {
+		i = jc_hash_fd(fd, (off_t)(ctx->length - check_len), (off_t)check_len, JC_HASH_FILE_PREAD, &check);
+		if (i != 0) return i;
+		if (check != get_le(state + 40, 8)) return -14;
+	}
+
+	if ((uint64_t)st.st_size == ctx->length) return 0;
+	return jc_hash_fd_update(ctx, fd, (off_t)ctx->length, 0, flags);
+}
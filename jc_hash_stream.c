@@ -0,0 +1,73 @@
+/* Streaming interface for jody_hash
+ *
+ * Hashes data of any length in pieces of any size. Partial words are
+ * carried in the context between calls so that the caller never has
+ * to pad or re-buffer anything.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "likely_unlikely.h"
+#include "jody_hash.h"
+#include "libjodycode.h"
+
+
+extern void jc_hash_init(struct jc_hash_ctx *ctx)
+{
+	memset(ctx, 0, sizeof(struct jc_hash_ctx));
+	return;
+}
+
+
+/* Add data to the hash; returns 0 on success */
+extern int jc_hash_update(struct jc_hash_ctx *ctx, const void *data, size_t count)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	size_t fill;
+
+	if (unlikely(ctx == NULL || (data == NULL && count != 0))) return -1;
+	if (count == 0) return 0;
+	ctx->length += count;
+
+	/* Complete a partial word left over from the last call */
+	if (ctx->tail_len != 0) {
+		fill = sizeof(jodyhash_t) - ctx->tail_len;
+		if (count < fill) {
+			memcpy((unsigned char *)&ctx->tail + ctx->tail_len, p, count);
+			ctx->tail_len += (unsigned int)count;
+			return 0;
+		}
+		memcpy((unsigned char *)&ctx->tail + ctx->tail_len, p, fill);
+		if (jody_block_hash(&ctx->tail, &ctx->hash, sizeof(jodyhash_t)) != 0) return 1;
+		ctx->tail = 0;
+		ctx->tail_len = 0;
+		p += fill; count -= fill;
+	}
+
+	/* Hash all whole words straight out of the caller's buffer */
+	fill = count & ~(sizeof(jodyhash_t) - 1);
+	if (fill != 0) {
+		if (jody_block_hash((const jodyhash_t *)(const void *)p, &ctx->hash, fill) != 0) return 1;
+		p += fill; count -= fill;
+	}
+
+	/* Keep any trailing bytes for the next call */
+	if (count != 0) {
+		memcpy(&ctx->tail, p, count);
+		ctx->tail_len = (unsigned int)count;
+	}
+	return 0;
+}
+
+
+/* Get the hash of everything added so far; the context is not changed,
+ * so more data can still be added afterwards */
+extern void jc_hash_final(const struct jc_hash_ctx *ctx, jodyhash_t *hash)
+{
+	*hash = ctx->hash;
+	if (ctx->tail_len != 0) jody_block_hash(&ctx->tail, hash, ctx->tail_len);
+	return;
+}
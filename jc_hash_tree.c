@@ -0,0 +1,241 @@
+/* Chunked tree hashing for jody_hash
+ *
+ * Normal jody_hash is strictly sequential, so one huge file can only be
+ * hashed as fast as one core can go. Tree mode splits the data into
+ * fixed-size chunks that are hashed independently (and in parallel),
+ * then hashes the list of chunk hashes in chunk order. Tree hashes are
+ * NOT jody_hash v7 hashes; they are versioned by JODY_HASH_TREE_VERSION.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+/* glibc only has O_DIRECT with _GNU_SOURCE */
+#ifndef _GNU_SOURCE
+ #define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef ON_WINDOWS
+ #include <sys/mman.h>
+#endif
+#include "likely_unlikely.h"
+#include "jody_hash.h"
+#include "libjodycode.h"
+#include "workers.h"
+
+#ifndef O_BINARY
+ #define O_BINARY 0
+#endif
+
+/* Alignment of the O_DIRECT probe read */
+#define TREE_DIRECT_ALIGN 4096
+
+/* Tree hash v1:
+ *  leaf[i] = jody_hash of bytes [i * CHUNK, (i + 1) * CHUNK) of the data
+ *  root    = jody_hash of leaf[0..n-1] then the data length, each stored
+ *            as a 64-bit little-endian word
+ * The chunk size is part of the format and must never change. */
+#define TREE_CHUNK JODY_HASH_TREE_CHUNK
+
+struct tree_state {
+	const unsigned char *data;
+	int fd;
+	int flags;
+	uint64_t length;
+	size_t chunks;
+	size_t next;
+	jodyhash_t *leaves;
+	int error;
+};
+
+
+static void *tree_worker(void *arg)
+{
+	struct tree_state *ts = (struct tree_state *)arg;
+	struct jc_hash_ctx ctx;
+	uint64_t offset, len;
+	size_t i;
+	int err;
+
+	while (1) {
+		i = JC_ATOMIC_NEXT(ts->next);
+		if (i >= ts->chunks) break;
+		offset = (uint64_t)i * TREE_CHUNK;
+		len = ts->length - offset;
+		if (len > TREE_CHUNK) len = TREE_CHUNK;
+		if (ts->data != NULL && (len & (sizeof(jodyhash_t) - 1)) == 0) {
+			ts->leaves[i] = 0;
+			jody_block_hash((const jodyhash_t *)(const void *)(ts->data + offset), &ts->leaves[i], (size_t)len);
+		} else if (ts->data != NULL) {
+			/* jody_block_hash() reads a partial last word whole, which
+			 * could go past the end of the caller's buffer */
+			jc_hash_init(&ctx);
+			jc_hash_update(&ctx, ts->data + offset, (size_t)len);
+			jc_hash_final(&ctx, &ts->leaves[i]);
+		} else {
+			err = jc_hash_fd(ts->fd, (off_t)offset, (off_t)len, ts->flags, &ts->leaves[i]);
+			if (err != 0) JC_ATOMIC_SET(ts->error, err);
+		}
+	}
+	return NULL;
+}
+
+
+/* Combine the chunk hashes in chunk order */
+static void tree_root(const struct tree_state *ts, jodyhash_t *hash)
+{
+	struct jc_hash_ctx ctx;
+	unsigned char word[8];
+	uint64_t val;
+
+	jc_hash_init(&ctx);
+	for (size_t i = 0; i <= ts->chunks; i++) {
+		val = (i < ts->chunks) ? (uint64_t)ts->leaves[i] : ts->length;
+		for (int j = 0; j < 8; j++) word[j] = (unsigned char)(val >> (j * 8));
+		jc_hash_update(&ctx, word, 8);
+	}
+	jc_hash_final(&ctx, hash);
+	return;
+}
+
+
+#if defined O_DIRECT && !defined ON_WINDOWS
+/* Turn on O_DIRECT for all workers at once; each worker leaves it alone
+ * when it is already on, so none can switch it off under another one.
+ * File systems that refuse it, either at once or on the first read, get
+ * NOCACHE instead. 'fl' is the file status flags from before. */
+static void tree_set_direct(struct tree_state *ts, const int fl)
+{
+	void *buf;
+	ssize_t got;
+
+	if (fl < 0) return;
+	if (!(fl & O_DIRECT)) {
+		if (fcntl(ts->fd, F_SETFL, fl | O_DIRECT) != 0) goto nocache;
+		if (posix_memalign(&buf, TREE_DIRECT_ALIGN, TREE_DIRECT_ALIGN) != 0) goto restore;
+		got = pread(ts->fd, buf, TREE_DIRECT_ALIGN, 0);
+		free(buf);
+		if (got < 0) goto restore;
+	}
+	return;
+
+restore:
+	fcntl(ts->fd, F_SETFL, fl);
+nocache:
+	ts->flags = (ts->flags & ~JC_HASH_FILE_DIRECT) | JC_HASH_FILE_NOCACHE;
+	return;
+}
+#endif /* O_DIRECT && !ON_WINDOWS */
+
+
+static int tree_run(struct tree_state *ts, unsigned int threads, jodyhash_t *hash)
+{
+	ts->chunks = (size_t)((ts->length + TREE_CHUNK - 1) / TREE_CHUNK);
+	ts->next = 0;
+	ts->error = 0;
+	ts->leaves = NULL;
+	if (ts->chunks != 0) {
+		ts->leaves = (jodyhash_t *)malloc(ts->chunks * sizeof(jodyhash_t));
+		if (unlikely(ts->leaves == NULL)) return -12;
+		threads = jc_worker_count(threads);
+		if (threads > ts->chunks) threads = (unsigned int)ts->chunks;
+		jc_run_workers(threads, tree_worker, ts);
+	}
+	if (ts->error == 0) tree_root(ts, hash);
+	free(ts->leaves);
+	return ts->error;
+}
+
+
+/* Tree hash a memory buffer on 'threads' threads (0 = one per CPU) */
+extern int jc_hash_tree(const void *data, const size_t count, const unsigned int threads, jodyhash_t *hash)
+{
+	struct tree_state ts;
+
+	if (unlikely((data == NULL && count != 0) || hash == NULL)) return -1;
+	ts.data = (const unsigned char *)data;
+	ts.fd = -1;
+	ts.flags = 0;
+	ts.length = count;
+	return tree_run(&ts, threads, hash);
+}
+
+
+/* Tree hash the first 'length' bytes (0 = all) of a regular file */
+extern int jc_hash_tree_fd(int fd, off_t length, const unsigned int threads, int flags, jodyhash_t *hash)
+{
+	struct tree_state ts;
+	struct stat st;
+#ifndef ON_WINDOWS
+	void *map;
+	int i;
+#endif
+
+	if (unlikely(fd < 0 || length < 0 || hash == NULL)) return -1;
+	/* Chunks are read at random offsets, so streams can't be used */
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return -11;
+	ts.data = NULL;
+	ts.fd = fd;
+	ts.flags = flags;
+	ts.length = (uint64_t)st.st_size;
+	if (length > 0 && (uint64_t)length < ts.length) ts.length = (uint64_t)length;
+
+	/* Sparse and uncached modes read the chunks. The workers share the
+	 * file offset (hole searches) and O_DIRECT is set for all of them, so
+	 * both are put back here once they are done. */
+	if (flags & (JC_HASH_FILE_SPARSE | JC_HASH_FILE_DIRECT | JC_HASH_FILE_NOCACHE)) {
+		const off_t pos = lseek(fd, 0, SEEK_CUR);
+#ifndef ON_WINDOWS
+		const int fl = fcntl(fd, F_GETFL);
+#endif
+		int err;
+
+#if defined O_DIRECT && !defined ON_WINDOWS
+		/* Sparse reads aren't aligned, so like jc_hash_fd() they treat
+		 * DIRECT as NOCACHE and O_DIRECT must stay off for them */
+		if ((flags & JC_HASH_FILE_DIRECT) && !(flags & JC_HASH_FILE_SPARSE) && ts.length != 0)
+			tree_set_direct(&ts, fl);
+#endif
+		err = tree_run(&ts, threads, hash);
+
+		if (pos >= 0) lseek(fd, pos, SEEK_SET);
+#ifndef ON_WINDOWS
+		if (fl >= 0) fcntl(fd, F_SETFL, fl);
+#endif
+		return err;
+	}
+
+#ifndef ON_WINDOWS
+	/* Map the whole range so the workers don't each copy their chunks;
+	 * if that fails (e.g. no address space), read chunks with pread() */
+	if (!(flags & JC_HASH_FILE_PREAD) && ts.length > TREE_CHUNK && ts.length <= SIZE_MAX) {
+		map = mmap(NULL, (size_t)ts.length, PROT_READ, MAP_SHARED, fd, 0);
+		if (map != MAP_FAILED) {
+			ts.data = (const unsigned char *)map;
+			i = tree_run(&ts, threads, hash);
+			munmap(map, (size_t)ts.length);
+			return i;
+		}
+	}
+#endif
+	return tree_run(&ts, threads, hash);
+}
+
+
+/* Tree hash a file by name; see jc_hash_tree_fd() */
+extern int jc_hash_tree_file(const char *path, off_t length, const unsigned int threads, int flags, jodyhash_t *hash)
+{
+	int fd, i;
+
+	if (unlikely(path == NULL || hash == NULL)) return -1;
+	fd = open(path, O_RDONLY | O_BINARY);
+	if (fd < 0) return -10;
+	i = jc_hash_tree_fd(fd, length, threads, flags, hash);
+	close(fd);
+	return i;
+}
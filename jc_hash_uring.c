@@ -0,0 +1,329 @@
+/* Asynchronous file hashing with io_uring
+ *
+ * Keeps a queue of reads in flight across many files at once and hashes
+ * each read as it completes, as soon as everything before it in the same
+ * file has been hashed. This lets one thread keep a fast SSD busy. If
+ * io_uring is not available, the synchronous hashing path is used.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "likely_unlikely.h"
+#include "libjodycode.h"
+#include "jc_uring.h"
+
+#ifdef JC_URING
+#include <sys/uio.h>
+
+/* Default and maximum number of reads in flight */
+#define URING_DEPTH_DEFAULT 32
+#define URING_DEPTH_MAX     1024
+/* Size of each read */
+#define URING_READ_SIZE     262144
+/* Reads in flight for a single file; the rest go to other files */
+#define URING_FILE_READS    4
+
+struct ustream;
+
+/* A read buffer; 'next' links the buffers of one file in read order */
+struct ubuf {
+	unsigned char *data;
+	struct iovec iov;
+	struct ustream *owner;
+	off_t offset;
+	int res;
+	int done;
+	int next;
+};
+
+/* A file being hashed */
+struct ustream {
+	struct jc_hash_job *job;
+	struct jc_hash_ctx ctx;
+	int fd;
+	int own_fd;
+	int status;
+	off_t submit_pos;
+	off_t end;
+	int head, tail;
+	unsigned int queued;
+};
+
+struct uring_state {
+	struct jc_uring ring;
+	struct ubuf *bufs;
+	unsigned char *data;
+	int *freelist;
+	unsigned int nfree;
+	struct ustream *streams;
+	unsigned int nstreams;
+};
+
+
+static void finish_stream(struct ustream *s)
+{
+	s->job->status = s->status;
+	if (s->status == 0) jc_hash_final(&s->ctx, &s->job->hash);
+	if (s->own_fd) close(s->fd);
+	s->job = NULL;
+	return;
+}
+
+
+/* Open a job's file and prepare to read it; returns 1 if the file needs
+ * asynchronous reads, 0 if the job was finished on the spot */
+static int start_stream(struct ustream *s, struct jc_hash_job *job, int flags)
+{
+	struct stat st;
+
+	job->hash = 0;
+	s->job = job;
+	s->fd = job->fd;
+	s->own_fd = 0;
+	if (s->fd < 0) {
+		if (unlikely(job->path == NULL)) {
+			job->status = -1;
+			s->job = NULL;
+			return 0;
+		}
+		s->fd = open(job->path, O_RDONLY);
+		if (s->fd < 0) {
+			job->status = -10;
+			s->job = NULL;
+			return 0;
+		}
+		s->own_fd = 1;
+	}
+
+	/* Only regular files have a size to split into reads; sparse and
+	 * uncached modes need their own read paths, so they are synchronous */
+	if ((flags & (JC_HASH_FILE_SPARSE | JC_HASH_FILE_DIRECT | JC_HASH_FILE_NOCACHE))
+			|| fstat(s->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		job->status = jc_hash_fd(s->fd, 0, job->length, flags, &job->hash);
+		if (s->own_fd) close(s->fd);
+		s->job = NULL;
+		return 0;
+	}
+
+	jc_hash_init(&s->ctx);
+	s->status = 0;
+	s->submit_pos = 0;
+	s->end = st.st_size;
+	if (job->length > 0 && job->length < s->end) s->end = job->length;
+	s->head = -1; s->tail = -1;
+	s->queued = 0;
+	if (s->end == 0) {
+		finish_stream(s);
+		return 0;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(s->fd, 0, s->end, POSIX_FADV_SEQUENTIAL);
+#endif
+	return 1;
+}
+
+
+/* Queue the next read of a file; returns 0 if no entry was available */
+static int queue_read(struct uring_state *us, struct ustream *s)
+{
+	struct io_uring_sqe *sqe;
+	struct ubuf *b;
+	int i;
+
+	sqe = jc_uring_get_sqe(&us->ring);
+	if (sqe == NULL) return 0;
+	i = us->freelist[--us->nfree];
+	b = &us->bufs[i];
+	b->owner = s;
+	b->offset = s->submit_pos;
+	b->iov.iov_base = b->data;
+	b->iov.iov_len = URING_READ_SIZE;
+	if ((uint64_t)(s->end - s->submit_pos) < URING_READ_SIZE) b->iov.iov_len = (size_t)(s->end - s->submit_pos);
+	b->done = 0;
+	b->next = -1;
+
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = s->fd;
+	sqe->off = (uint64_t)b->offset;
+	sqe->addr = (uint64_t)(uintptr_t)&b->iov;
+	sqe->len = 1;
+	sqe->user_data = (unsigned int)i;
+
+	if (s->tail >= 0) us->bufs[s->tail].next = i;
+	else s->head = i;
+	s->tail = i;
+	s->queued++;
+	s->submit_pos += (off_t)b->iov.iov_len;
+	return 1;
+}
+
+
+/* Hash the completed reads at the front of a file's queue
+ * A short or failed read rewinds submit_pos; reads that were already
+ * queued past that point are thrown away when they complete */
+static void consume_reads(struct uring_state *us, struct ustream *s)
+{
+	struct ubuf *b;
+	int i;
+
+	while (s->head >= 0 && us->bufs[s->head].done) {
+		i = s->head;
+		b = &us->bufs[i];
+		s->head = b->next;
+		if (s->head < 0) s->tail = -1;
+		s->queued--;
+
+		if (s->status == 0 && b->offset == (off_t)s->ctx.length) {
+			if (b->res == -EINTR || b->res == -EAGAIN) {
+				s->submit_pos = b->offset;
+			} else if (b->res < 0) {
+				s->status = -11;
+			} else if (b->res == 0) {
+				/* The file shrank; stop at the new EOF */
+				s->end = b->offset;
+			} else {
+				jc_hash_update(&s->ctx, b->data, (size_t)b->res);
+				if ((size_t)b->res < b->iov.iov_len) s->submit_pos = (off_t)s->ctx.length;
+			}
+		}
+		us->freelist[us->nfree++] = i;
+	}
+	return;
+}
+
+
+static void free_state(struct uring_state *us)
+{
+	free(us->bufs);
+	free(us->data);
+	free(us->freelist);
+	free(us->streams);
+	return;
+}
+
+
+static int alloc_state(struct uring_state *us, unsigned int depth)
+{
+	us->nstreams = depth;
+	us->nfree = depth;
+	us->bufs = (struct ubuf *)calloc(depth, sizeof(struct ubuf));
+	us->data = (unsigned char *)malloc((size_t)depth * URING_READ_SIZE);
+	us->freelist = (int *)malloc(depth * sizeof(int));
+	us->streams = (struct ustream *)calloc(depth, sizeof(struct ustream));
+	if (us->bufs == NULL || us->data == NULL || us->freelist == NULL || us->streams == NULL) {
+		free_state(us);
+		return -12;
+	}
+	for (unsigned int i = 0; i < depth; i++) {
+		us->bufs[i].data = us->data + (size_t)i * URING_READ_SIZE;
+		us->freelist[i] = (int)i;
+	}
+	return 0;
+}
+#endif /* JC_URING */
+
+
+/* Hash many files from one thread with up to 'depth' reads in flight
+ * (0 = default). Jobs work the same way as for jc_hash_files(), which is
+ * also what gets used if io_uring can't be set up. Returns the number of
+ * failed jobs. */
+extern int jc_hash_files_async(struct jc_hash_job *jobs, const size_t count, unsigned int depth, const int flags)
+{
+#ifdef JC_URING
+	struct uring_state us;
+	struct io_uring_cqe *cqe;
+	struct ubuf *b;
+	struct ustream *s;
+	size_t next = 0;
+	unsigned int active = 0, i;
+	int err, failed = 0;
+
+	if (unlikely(jobs == NULL && count != 0)) return -1;
+	if (count == 0) return 0;
+	if (depth == 0) depth = URING_DEPTH_DEFAULT;
+	if (depth > URING_DEPTH_MAX) depth = URING_DEPTH_MAX;
+
+	if (jc_uring_init(&us.ring, depth) != 0) goto fallback;
+	if (alloc_state(&us, depth) != 0) {
+		jc_uring_exit(&us.ring);
+		goto fallback;
+	}
+
+	while (next < count || active > 0) {
+		/* Start more files while there are buffers to read them into */
+		for (i = 0; i < us.nstreams && next < count && us.nfree > 0; i++) {
+			if (us.streams[i].job != NULL) continue;
+			while (next < count && start_stream(&us.streams[i], &jobs[next], flags) == 0) next++;
+			if (next < count) {
+				next++;
+				active++;
+			}
+		}
+
+		/* Spread free buffers over the files that still need data */
+		for (i = 0; i < us.nstreams && us.nfree > 0; i++) {
+			s = &us.streams[i];
+			if (s->job == NULL) continue;
+			while (us.nfree > 0 && s->status == 0 && s->queued < URING_FILE_READS && s->submit_pos < s->end)
+				if (queue_read(&us, s) == 0) break;
+		}
+
+		if (active == 0) continue;
+		err = jc_uring_submit(&us.ring, 1);
+		if (err != 0 && err != -EAGAIN && err != -EBUSY) goto abort;
+
+		while ((cqe = jc_uring_peek_cqe(&us.ring)) != NULL) {
+			b = &us.bufs[cqe->user_data];
+			b->res = cqe->res;
+			b->done = 1;
+			jc_uring_cqe_seen(&us.ring);
+			s = b->owner;
+			consume_reads(&us, s);
+			if (s->queued == 0 && (s->status != 0 || (off_t)s->ctx.length >= s->end)) {
+				finish_stream(s);
+				active--;
+			}
+		}
+	}
+
+	jc_uring_exit(&us.ring);
+	free_state(&us);
+	for (size_t j = 0; j < count; j++) if (jobs[j].status != 0) failed++;
+	return failed;
+
+abort:
+	/* Reads already running finish even after the ring is closed, so
+	 * they are waited for before their buffers go away (or the buffers
+	 * are leaked if that isn't possible). Files being read fail and the
+	 * jobs that were never started are hashed synchronously. */
+	err = jc_uring_drain(&us.ring);
+	jc_uring_exit(&us.ring);
+	for (i = 0; i < us.nstreams; i++) {
+		s = &us.streams[i];
+		if (s->job == NULL) continue;
+		s->status = -11;
+		finish_stream(s);
+	}
+	if (err == 0) free_state(&us);
+	else {
+		free(us.freelist);
+		free(us.streams);
+	}
+	if (next < count) jc_hash_files(jobs + next, count - next, 1, flags);
+	for (size_t j = 0; j < count; j++) if (jobs[j].status != 0) failed++;
+	return failed;
+
+fallback:
+#else
+	(void)depth;
+#endif /* JC_URING */
+	return jc_hash_files(jobs, count, 1, flags);
+}
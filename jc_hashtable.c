@@ -0,0 +1,289 @@
+/* Open addressing hash table keyed by jodyhash_t
+ *
+ * Maps hashes to groups of 64-bit values (file indexes, pointers cast to
+ * integers, etc.) so programs can group files by hash without building
+ * their own trees or lists. Distinct keys live in a linear probing table
+ * kept as separate arrays: a metadata byte, the key, and the group info.
+ * Most probes only touch the metadata array. Values are stored in the
+ * order they were added and chained by 32-bit index within each group.
+ *
+ * Memory cost is 12 bytes per value plus 21 bytes per table slot; the
+ * table is kept between 3/8 and 3/4 full of distinct keys.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "likely_unlikely.h"
+#include "libjodycode.h"
+
+#define HT_MIN_SLOTS 64
+/* Value indexes are 32-bit; the largest one marks the end of a chain */
+#define HT_END UINT32_MAX
+#define HT_MAX_ENTRIES ((size_t)UINT32_MAX - 1)
+/* How far ahead bulk inserts prefetch */
+#define HT_PREFETCH 8
+
+struct ht_group {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t count;
+};
+
+struct jc_hashtable {
+	/* Distinct keys: metadata is 0 for an empty slot, or 0x80 plus the
+	 * low 7 bits of the key so most mismatches never load the key */
+	unsigned char *meta;
+	jodyhash_t *keys;
+	struct ht_group *groups;
+	size_t slots;
+	unsigned int shift;
+	size_t used;
+	/* Values in insertion order */
+	uint64_t *values;
+	uint32_t *next;
+	size_t entries;
+	size_t capacity;
+};
+
+
+/* Keys are hashes already, but mixing them keeps the home slots spread
+ * out even if the low bits are poor */
+static inline size_t ht_home(const struct jc_hashtable *ht, const jodyhash_t key)
+{
+	return (size_t)(((uint64_t)key * 0x9e3779b97f4a7c15ULL) >> ht->shift);
+}
+
+static inline unsigned char ht_tag(const jodyhash_t key)
+{
+	return (unsigned char)(0x80 | (key & 0x7f));
+}
+
+
+/* Find a key's slot, or the empty slot where it would go */
+static size_t ht_find(const struct jc_hashtable *ht, const jodyhash_t key)
+{
+	const unsigned char tag = ht_tag(key);
+	const size_t mask = ht->slots - 1;
+	size_t i = ht_home(ht, key);
+
+	while (ht->meta[i] != 0) {
+		if (ht->meta[i] == tag && ht->keys[i] == key) break;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+
+static int ht_alloc_slots(struct jc_hashtable *ht, size_t slots)
+{
+	unsigned int bits = 0;
+
+	while (((size_t)1 << bits) < slots) bits++;
+	ht->meta = (unsigned char *)calloc(slots, 1);
+	ht->keys = (jodyhash_t *)malloc(slots * sizeof(jodyhash_t));
+	ht->groups = (struct ht_group *)malloc(slots * sizeof(struct ht_group));
+	if (unlikely(ht->meta == NULL || ht->keys == NULL || ht->groups == NULL)) {
+		free(ht->meta);
+		free(ht->keys);
+		free(ht->groups);
+		ht->meta = NULL;
+		ht->keys = NULL;
+		ht->groups = NULL;
+		return -12;
+	}
+	ht->slots = slots;
+	ht->shift = 64 - bits;
+	return 0;
+}
+
+
+/* Double the key table; the values don't move */
+static int ht_grow_slots(struct jc_hashtable *ht)
+{
+	struct jc_hashtable old = *ht;
+	size_t i, j;
+
+	if (ht_alloc_slots(ht, old.slots * 2) != 0) {
+		*ht = old;
+		return -12;
+	}
+	for (i = 0; i < old.slots; i++) {
+		if (old.meta[i] == 0) continue;
+		j = ht_find(ht, old.keys[i]);
+		ht->meta[j] = old.meta[i];
+		ht->keys[j] = old.keys[i];
+		ht->groups[j] = old.groups[i];
+	}
+	free(old.meta);
+	free(old.keys);
+	free(old.groups);
+	return 0;
+}
+
+
+static int ht_reserve_entries(struct jc_hashtable *ht, size_t need)
+{
+	uint64_t *values;
+	uint32_t *next;
+	size_t capacity = ht->capacity ? ht->capacity : HT_MIN_SLOTS;
+
+	if (need <= ht->capacity) return 0;
+	if (need > HT_MAX_ENTRIES) return -12;
+	while (capacity < need) capacity = (capacity > HT_MAX_ENTRIES / 2) ? HT_MAX_ENTRIES : capacity * 2;
+	values = (uint64_t *)realloc(ht->values, capacity * sizeof(uint64_t));
+	if (unlikely(values == NULL)) return -12;
+	ht->values = values;
+	next = (uint32_t *)realloc(ht->next, capacity * sizeof(uint32_t));
+	if (unlikely(next == NULL)) return -12;
+	ht->next = next;
+	ht->capacity = capacity;
+	return 0;
+}
+
+
+/* Create a table sized for 'expected' values with distinct keys; it
+ * grows as needed, but sizing it up front avoids rehashing */
+extern int jc_hashtable_init(struct jc_hashtable **table, const size_t expected)
+{
+	struct jc_hashtable *ht;
+	size_t slots = HT_MIN_SLOTS;
+
+	if (unlikely(table == NULL)) return -1;
+	*table = NULL;
+	ht = (struct jc_hashtable *)calloc(1, sizeof(struct jc_hashtable));
+	if (unlikely(ht == NULL)) return -12;
+	while (slots / 4 * 3 < expected && slots < (SIZE_MAX / 2)) slots *= 2;
+	if (ht_alloc_slots(ht, slots) != 0 || ht_reserve_entries(ht, expected > HT_MIN_SLOTS ? expected : HT_MIN_SLOTS) != 0) {
+		jc_hashtable_free(ht);
+		return -12;
+	}
+	*table = ht;
+	return 0;
+}
+
+
+extern void jc_hashtable_free(struct jc_hashtable *ht)
+{
+	if (ht == NULL) return;
+	free(ht->meta);
+	free(ht->keys);
+	free(ht->groups);
+	free(ht->values);
+	free(ht->next);
+	free(ht);
+	return;
+}
+
+
+/* Add a value to the group for 'key' */
+extern int jc_hashtable_insert(struct jc_hashtable *ht, const jodyhash_t key, const uint64_t value)
+{
+	struct ht_group *g;
+	uint32_t idx;
+	size_t i;
+
+	if (unlikely(ht == NULL)) return -1;
+	if (ht->entries == ht->capacity && ht_reserve_entries(ht, ht->entries + 1) != 0) return -12;
+	if ((ht->used + 1) * 4 > ht->slots * 3 && ht_grow_slots(ht) != 0) return -12;
+
+	idx = (uint32_t)ht->entries;
+	ht->values[idx] = value;
+	ht->next[idx] = HT_END;
+	ht->entries++;
+
+	i = ht_find(ht, key);
+	g = &ht->groups[i];
+	if (ht->meta[i] == 0) {
+		ht->meta[i] = ht_tag(key);
+		ht->keys[i] = key;
+		g->head = idx;
+		g->count = 0;
+		ht->used++;
+	} else ht->next[g->tail] = idx;
+	g->tail = idx;
+	g->count++;
+	return 0;
+}
+
+
+/* Add many key/value pairs; slots for upcoming keys are prefetched so
+ * the cache misses overlap instead of happening one at a time */
+extern int jc_hashtable_insert_many(struct jc_hashtable *ht, const jodyhash_t *keys, const uint64_t *values, const size_t count)
+{
+	int i;
+
+	if (unlikely(ht == NULL || ((keys == NULL || values == NULL) && count != 0))) return -1;
+	if (ht_reserve_entries(ht, ht->entries + count) != 0) return -12;
+	for (size_t j = 0; j < count; j++) {
+#if defined __GNUC__ || defined __clang__
+		if (j + HT_PREFETCH < count) {
+			const size_t h = ht_home(ht, keys[j + HT_PREFETCH]);
+			__builtin_prefetch(&ht->meta[h]);
+			__builtin_prefetch(&ht->keys[h]);
+		}
+#endif
+		i = jc_hashtable_insert(ht, keys[j], values[j]);
+		if (i != 0) return i;
+	}
+	return 0;
+}
+
+
+/* Get the number of values stored for 'key' and copy up to 'max' of them
+ * (in insertion order) to 'values' */
+extern size_t jc_hashtable_lookup(const struct jc_hashtable *ht, const jodyhash_t key, uint64_t *values, const size_t max)
+{
+	const struct ht_group *g;
+	uint32_t idx;
+	size_t i, n = 0;
+
+	if (unlikely(ht == NULL)) return 0;
+	i = ht_find(ht, key);
+	if (ht->meta[i] == 0) return 0;
+	g = &ht->groups[i];
+	if (values != NULL)
+		for (idx = g->head; idx != HT_END && n < max; idx = ht->next[idx]) values[n++] = ht->values[idx];
+	return g->count;
+}
+
+
+/* Call func() for every group with at least 'min_count' values; the values
+ * are passed as one array in insertion order. A nonzero return from func()
+ * stops the walk and is returned. */
+extern int jc_hashtable_foreach_group(const struct jc_hashtable *ht, const size_t min_count,
+		int (*func)(const jodyhash_t key, const uint64_t *values, const size_t count, void *arg), void *arg)
+{
+	uint64_t *scratch;
+	uint32_t idx, max = 0;
+	size_t i, n;
+	int ret = 0;
+
+	if (unlikely(ht == NULL || func == NULL)) return -1;
+	for (i = 0; i < ht->slots; i++)
+		if (ht->meta[i] != 0 && ht->groups[i].count > max) max = ht->groups[i].count;
+	if (max == 0 || max < min_count) return 0;
+	scratch = (uint64_t *)malloc(max * sizeof(uint64_t));
+	if (unlikely(scratch == NULL)) return -12;
+
+	for (i = 0; i < ht->slots && ret == 0; i++) {
+		if (ht->meta[i] == 0 || ht->groups[i].count < min_count) continue;
+		n = 0;
+		for (idx = ht->groups[i].head; idx != HT_END; idx = ht->next[idx]) scratch[n++] = ht->values[idx];
+		ret = func(ht->keys[i], scratch, n, arg);
+	}
+	free(scratch);
+	return ret;
+}
+
+
+/* Number of values and of distinct keys in the table */
+extern void jc_hashtable_stats(const struct jc_hashtable *ht, size_t *entries, size_t *groups)
+{
+	if (entries != NULL) *entries = ht ? ht->entries : 0;
+	if (groups != NULL) *groups = ht ? ht->used : 0;
+	return;
+}
@@ -0,0 +1,160 @@
+/* Minimal io_uring helper
+ *
+ * Just enough of io_uring to queue reads and collect their results,
+ * talking to the kernel directly so there is no liburing dependency.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include "jc_uring.h"
+
+#ifdef JC_URING
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define RING_PTR(base, off) ((unsigned int *)(void *)((unsigned char *)(base) + (off)))
+
+
+/* Set up a ring with room for 'entries' requests; returns 0 on success */
+extern int jc_uring_init(struct jc_uring *ring, unsigned int entries)
+{
+	struct io_uring_params p;
+	long fd;
+
+	memset(ring, 0, sizeof(struct jc_uring));
+	memset(&p, 0, sizeof(struct io_uring_params));
+	ring->fd = -1;
+	fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (fd < 0) return -1;
+	ring->fd = (int)fd;
+	ring->entries = p.sq_entries;
+
+	ring->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	/* Newer kernels map both rings with a single mmap() */
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_map_len > ring->sq_map_len) ring->sq_map_len = ring->cq_map_len;
+		ring->cq_map_len = 0;
+	}
+
+	ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_map == MAP_FAILED) goto error_sq;
+	if (ring->cq_map_len == 0) ring->cq_map = ring->sq_map;
+	else {
+		ring->cq_map = mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_map == MAP_FAILED) goto error_cq;
+	}
+	ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) goto error_sqes;
+
+	ring->sq_head  = RING_PTR(ring->sq_map, p.sq_off.head);
+	ring->sq_tail  = RING_PTR(ring->sq_map, p.sq_off.tail);
+	ring->sq_mask  = RING_PTR(ring->sq_map, p.sq_off.ring_mask);
+	ring->sq_array = RING_PTR(ring->sq_map, p.sq_off.array);
+	ring->cq_head  = RING_PTR(ring->cq_map, p.cq_off.head);
+	ring->cq_tail  = RING_PTR(ring->cq_map, p.cq_off.tail);
+	ring->cq_mask  = RING_PTR(ring->cq_map, p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(void *)((unsigned char *)ring->cq_map + p.cq_off.cqes);
+	ring->sq_local_tail = *ring->sq_tail;
+	return 0;
+
+error_sqes:
+	if (ring->cq_map_len != 0) munmap(ring->cq_map, ring->cq_map_len);
+error_cq:
+	munmap(ring->sq_map, ring->sq_map_len);
+error_sq:
+	close(ring->fd);
+	ring->fd = -1;
+	return -1;
+}
+
+
+extern void jc_uring_exit(struct jc_uring *ring)
+{
+	if (ring->fd < 0) return;
+	munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_map_len != 0) munmap(ring->cq_map, ring->cq_map_len);
+	munmap(ring->sq_map, ring->sq_map_len);
+	close(ring->fd);
+	ring->fd = -1;
+	return;
+}
+
+
+/* Get a cleared submission entry, or NULL if the queue is full */
+extern struct io_uring_sqe *jc_uring_get_sqe(struct jc_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int idx;
+
+	if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->entries) return NULL;
+	idx = ring->sq_local_tail & *ring->sq_mask;
+	sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	ring->sq_array[idx] = idx;
+	ring->sq_local_tail++;
+	ring->to_submit++;
+	return sqe;
+}
+
+
+/* Submit queued entries and optionally wait for 'wait' completions
+ * Returns 0 on success or a negative errno value */
+extern int jc_uring_submit(struct jc_uring *ring, unsigned int wait)
+{
+	long i;
+
+	__atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+	do {
+		i = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (i < 0 && errno == EINTR);
+	if (i < 0) return -errno;
+	ring->to_submit -= (unsigned int)i;
+	ring->inflight += (unsigned int)i;
+	return 0;
+}
+
+
+/* Get the next completion without waiting, or NULL if there is none */
+extern struct io_uring_cqe *jc_uring_peek_cqe(struct jc_uring *ring)
+{
+	unsigned int head = *ring->cq_head;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+	return &ring->cqes[head & *ring->cq_mask];
+}
+
+
+/* Release the completion returned by jc_uring_peek_cqe() */
+extern void jc_uring_cqe_seen(struct jc_uring *ring)
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+	ring->inflight--;
+	return;
+}
+
+
+/* Wait for and throw away the completions of every request the kernel
+ * has taken. Closing the ring doesn't wait for reads that are already
+ * running, so their buffers can only be freed after this returns 0.
+ * Returns -1 if the ring can't be waited on; the buffers of any reads
+ * still in flight must then never be freed. */
+extern int jc_uring_drain(struct jc_uring *ring)
+{
+	long i;
+
+	while (1) {
+		while (jc_uring_peek_cqe(ring) != NULL) jc_uring_cqe_seen(ring);
+		if (ring->inflight == 0) return 0;
+		do {
+			i = syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		} while (i < 0 && errno == EINTR);
+		if (i < 0) return -1;
+	}
+}
+
+#endif /* JC_URING */
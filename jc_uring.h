@@ -0,0 +1,55 @@
+/* Minimal io_uring helper (internal to libjodycode)
+ * See jc_uring.c for license information */
+
+#ifndef JC_URING_H
+#define JC_URING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* io_uring is only used on Linux and is called through raw syscalls
+ * so that liburing is not needed; build with NO_URING=1 to leave it out */
+#if defined __linux__ && !defined NO_URING
+ #include <sys/syscall.h>
+ #if defined __NR_io_uring_setup && defined __NR_io_uring_enter
+  #define JC_URING
+ #endif
+#endif
+
+#ifdef JC_URING
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+struct jc_uring {
+	int fd;
+	unsigned int entries;
+	/* Submission queue */
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned int sq_local_tail;
+	unsigned int to_submit;
+	/* Requests the kernel has taken that haven't been seen completing */
+	unsigned int inflight;
+	/* Completion queue */
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	/* Mappings to release on exit */
+	void *sq_map, *cq_map;
+	size_t sq_map_len, cq_map_len, sqes_len;
+};
+
+extern int jc_uring_init(struct jc_uring *ring, unsigned int entries);
+extern void jc_uring_exit(struct jc_uring *ring);
+extern struct io_uring_sqe *jc_uring_get_sqe(struct jc_uring *ring);
+extern int jc_uring_submit(struct jc_uring *ring, unsigned int wait);
+extern struct io_uring_cqe *jc_uring_peek_cqe(struct jc_uring *ring);
+extern void jc_uring_cqe_seen(struct jc_uring *ring);
+extern int jc_uring_drain(struct jc_uring *ring);
+#endif /* JC_URING */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JC_URING_H */
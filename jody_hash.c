@@ -15,9 +15,149 @@
 #include "jody_hash.h"
 #include "jody_hash_simd.h"
 #include "likely_unlikely.h"
+#include "workers.h"
 
 static const jodyhash_t jh_s_constant = JH_ROR2(JODY_HASH_CONSTANT);
 
+int jody_hash_cpu_avx = 0;
+
+static void jody_block_hash_wide_scalar(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks);
+static size_t jody_memdiff_scalar(const unsigned char *a, const unsigned char *b, const size_t count);
+static size_t jody_zero_span_scalar(const unsigned char *data, const size_t count);
+
+/* Kernel table, indexed by JODY_HASH_KERNEL_*; NULL block = not built */
+static const struct jody_hash_kernel jh_kernels[JODY_HASH_KERNEL_MAX + 1] = {
+	{ "auto",   NULL, NULL, NULL, NULL, NULL, NULL, 1 },
+	{ "scalar", NULL, NULL, jody_block_hash_wide_scalar, jody_memdiff_scalar, jody_zero_span_scalar, NULL, 1 },
+#ifndef NO_SSE2
+	{ "sse2",   jody_block_hash_sse2, jody_block_hash_multi_sse2, jody_block_hash_wide_sse2, jody_memdiff_sse2, jody_zero_span_sse2, jody_block_hash128_sse2, 2 },
+#else
+	{ "sse2",   NULL, NULL, NULL, NULL, NULL, NULL, 1 },
+#endif
+#ifndef NO_AVX2
+	{ "avx2",   jody_block_hash_avx2, jody_block_hash_multi_avx2, jody_block_hash_wide_avx2, jody_memdiff_avx2, jody_zero_span_avx2, jody_block_hash128_avx2, 4 },
+#else
+	{ "avx2",   NULL, NULL, NULL, NULL, NULL, NULL, 1 },
+#endif
+#ifndef NO_AVX512
+	{ "avx512", jody_block_hash_avx512, jody_block_hash_multi_avx512, jody_block_hash_wide_avx512, jody_memdiff_avx512, jody_zero_span_avx512, jody_block_hash128_avx512, 8 },
+#else
+	{ "avx512", NULL, NULL, NULL, NULL, NULL, NULL, 1 },
+#endif
+#ifndef NO_VEC
+	{ "vec",    jody_block_hash_vec, jody_block_hash_multi_vec, jody_block_hash_wide_vec, jody_memdiff_vec, jody_zero_span_vec, jody_block_hash128_vec, 4 },
+#else
+	{ "vec",    NULL, NULL, NULL, NULL, NULL, NULL, 1 },
+#endif
+};
+
+/* Automatic selection order, fastest first; the portable kernel goes last
+ * since the CPU-specific kernels beat it wherever they can run */
+static const int jh_kernel_order[] = {
+	JODY_HASH_KERNEL_AVX512, JODY_HASH_KERNEL_AVX2, JODY_HASH_KERNEL_SSE2, JODY_HASH_KERNEL_VEC
+};
+
+/* Read and written atomically since hashing threads use it while the
+ * kernel can be switched; the table it points into never changes */
+static const struct jody_hash_kernel *jh_kernel = NULL;
+
+
+/* Can this CPU run a kernel that was built into the library? */
+static int jh_kernel_usable(const int kernel)
+{
+	if (kernel == JODY_HASH_KERNEL_SCALAR) return 1;
+	if (kernel <= JODY_HASH_KERNEL_AUTO || kernel > JODY_HASH_KERNEL_MAX) return 0;
+	if (jh_kernels[kernel].block == NULL) return 0;
+#if defined __GNUC__ || defined __clang__
+	switch (kernel) {
+		case JODY_HASH_KERNEL_SSE2: return __builtin_cpu_supports("sse2");
+		case JODY_HASH_KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+		case JODY_HASH_KERNEL_AVX512: return __builtin_cpu_supports("avx512f");
+		case JODY_HASH_KERNEL_VEC: return 1;
+		default: return 0;
+	}
+#else
+	return 1;
+#endif /* __GNUC__ || __clang__ */
+}
+
+
+/* Pick a kernel: the JODY_HASH_KERNEL environment variable wins if it
+ * names a usable kernel, otherwise the fastest usable kernel is used */
+static int jh_kernel_auto(void)
+{
+	const char *env;
+	int kernel;
+
+#if defined __GNUC__ || defined __clang__
+	__builtin_cpu_init();
+#endif
+	env = getenv("JODY_HASH_KERNEL");
+	if (env != NULL) {
+		for (kernel = JODY_HASH_KERNEL_SCALAR; kernel <= JODY_HASH_KERNEL_MAX; kernel++)
+			if (strcmp(env, jh_kernels[kernel].name) == 0 && jh_kernel_usable(kernel)) return kernel;
+	}
+	for (size_t i = 0; i < sizeof(jh_kernel_order) / sizeof(int); i++)
+		if (jh_kernel_usable(jh_kernel_order[i])) return jh_kernel_order[i];
+	return JODY_HASH_KERNEL_SCALAR;
+}
+
+
+/* Select a kernel; returns -9 if the requested kernel can't be used here */
+extern int jody_hash_set_kernel(const int kernel)
+{
+	int selected = kernel;
+#if defined __GNUC__ || defined __clang__
+	int avx;
+#endif
+
+	if (kernel == JODY_HASH_KERNEL_AUTO) selected = jh_kernel_auto();
+	else {
+#if defined __GNUC__ || defined __clang__
+		__builtin_cpu_init();
+#endif
+		if (!jh_kernel_usable(kernel)) return -9;
+	}
+#if defined __GNUC__ || defined __clang__
+	/* Only written once (at load time) since the kernels read it */
+	avx = (__builtin_cpu_supports("avx") != 0);
+	if (jody_hash_cpu_avx != avx) jody_hash_cpu_avx = avx;
+#endif
+	JC_ATOMIC_SET(jh_kernel, &jh_kernels[selected]);
+	return 0;
+}
+
+
+/* The selected kernel; compilers without constructor support resolve it
+ * on first use */
+static inline const struct jody_hash_kernel *jh_get_kernel(void)
+{
+	const struct jody_hash_kernel *kernel = JC_ATOMIC_GET(jh_kernel);
+
+	if (unlikely(kernel == NULL)) {
+		jody_hash_set_kernel(JODY_HASH_KERNEL_AUTO);
+		kernel = JC_ATOMIC_GET(jh_kernel);
+	}
+	return kernel;
+}
+
+
+extern int jody_hash_get_kernel(void)
+{
+	return (int)(jh_get_kernel() - jh_kernels);
+}
+
+
+/* Resolve the kernel when the library is loaded instead of on every call */
+#if defined __GNUC__ || defined __clang__
+__attribute__((constructor))
+static void jh_kernel_init(void)
+{
+	if (JC_ATOMIC_GET(jh_kernel) == NULL) jody_hash_set_kernel(JODY_HASH_KERNEL_AUTO);
+}
+#endif
+
+
 /* Hash a block of arbitrary size; must be divisible by sizeof(jodyhash_t)
  * The first block should pass an initial hash of zero.
  * All blocks after the first should pass hash as the value
@@ -25,53 +165,25 @@ static const jodyhash_t jh_s_constant = JH_ROR2(JODY_HASH_CONSTANT);
  * of any amount of data. If data is not divisible by the size of
  * jodyhash_t, it is MANDATORY that the caller provide a data buffer
  * which is divisible by sizeof(jodyhash_t). */
-extern int jody_block_hash(jodyhash_t *data, jodyhash_t *hash, const size_t count)
+extern int jody_block_hash(const jodyhash_t *data, jodyhash_t *hash, const size_t count)
 {
 	jodyhash_t element, element2;
-	size_t length = 0;
+	const struct jody_hash_kernel *kernel;
+	size_t length;
 
 	/* Don't bother trying to hash a zero-length block */
 	if (unlikely(count == 0)) return 0;
 
-#ifndef NO_AVX2
-#if defined __GNUC__ || defined __clang__
-	__builtin_cpu_init ();
-	if (__builtin_cpu_supports ("avx2")) {
-#endif /* __GNUC__ || __clang__ */
-		if (count >= 32) {
-			if (jody_block_hash_avx2(&data, hash, count, &length) != 0) return 1;
-			goto skip_sse2;
-		} else length = count / sizeof(jodyhash_t);
-#if defined __GNUC__ || defined __clang__
-	} else length = count / sizeof(jodyhash_t);
-#endif
-#else
-	length = count / sizeof(jodyhash_t);
-#endif /* NO_AVX2 */
-
+	kernel = jh_get_kernel();
 
-#ifndef NO_SSE2
-#if defined __GNUC__ || defined __clang__
-	__builtin_cpu_init ();
-	if (__builtin_cpu_supports ("sse2")) {
-#endif /* __GNUC__ || __clang__ */
-		if (count >= 32) {
-			if (jody_block_hash_sse2(&data, hash, count, &length) != 0) return 1;
-		}
-		else length = count / sizeof(jodyhash_t);
-#if defined __GNUC__ || defined __clang__
+	if (count >= 32 && kernel->block != NULL) {
+		if (kernel->block(&data, hash, count, &length) != 0) return 1;
 	} else length = count / sizeof(jodyhash_t);
-#endif
-#else
-	length = count / sizeof(jodyhash_t);
-#endif /* NO_SSE2 */
 
-#ifndef NO_AVX2
-skip_sse2:
-#endif
 	/* Hash everything (normal) or remaining small tails (SSE2) */
 	for (; length > 0; length--) {
-		element = *data;
+		/* memcpy() keeps unaligned data safe on strict-alignment CPUs */
+		memcpy(&element, data, sizeof(jodyhash_t));
 		element2 = JH_ROR(element);
 		element2 ^= jh_s_constant;
 		element += JODY_HASH_CONSTANT;
@@ -97,3 +209,238 @@ skip_sse2:
 
 	return 0;
 }
+
+
+/* Same as jody_block_hash() over 'words' zero words, without any loads
+ * For a zero word the round is h = ROL2((h + C) ^ ROR2(C)) + C; tracking
+ * g = h + C instead turns that into g = (ROL2(g) ^ C) + 2C, which is one
+ * fewer step in the serial chain. Used to hash holes in sparse files. */
+extern void jody_block_hash_zeroes(jodyhash_t *hash, uint64_t words)
+{
+	jodyhash_t g = *hash + JODY_HASH_CONSTANT;
+
+	for (; words > 0; words--) g = (JH_ROL2(g) ^ JODY_HASH_CONSTANT) + JODY_HASH_CONSTANT * 2;
+	*hash = g - JODY_HASH_CONSTANT;
+	return;
+}
+
+
+/* Hash several equal-sized buffers at once, one per SIMD lane
+ * Each hash[i] gets the same result as jody_block_hash(data[i], &hash[i], count) */
+extern int jody_block_hash_multi(const jodyhash_t * const *data, jodyhash_t *hash, const size_t buffers, const size_t count)
+{
+	const jodyhash_t *lane_data[JODY_HASH_MAX_LANES];
+	jodyhash_t lane_hash[JODY_HASH_MAX_LANES];
+	const struct jody_hash_kernel *kernel;
+	size_t i = 0, j, lanes, done;
+
+	if (unlikely(count == 0 || buffers == 0)) return 0;
+	kernel = jh_get_kernel();
+
+	if (kernel->multi != NULL) {
+		lanes = kernel->lanes;
+		while (i < buffers) {
+			/* Fill lanes past the last buffer with a dummy copy of it */
+			for (j = 0; j < lanes; j++) {
+				if (i + j < buffers) {
+					lane_data[j] = data[i + j];
+					lane_hash[j] = hash[i + j];
+				} else {
+					lane_data[j] = data[buffers - 1];
+					lane_hash[j] = 0;
+				}
+			}
+			done = kernel->multi(lane_data, lane_hash, count);
+			for (j = 0; j < lanes && i < buffers; j++, i++) {
+				if (done < count && jody_block_hash(lane_data[j] + (done / sizeof(jodyhash_t)), &lane_hash[j], count - done) != 0) return 1;
+				hash[i] = lane_hash[j];
+			}
+		}
+		return 0;
+	}
+
+	for (; i < buffers; i++) if (jody_block_hash(data[i], &hash[i], count) != 0) return 1;
+	return 0;
+}
+
+
+/* One jody_hash round on a single accumulator */
+static inline jodyhash_t jh_wide_step(jodyhash_t h, const jodyhash_t w)
+{
+	const jodyhash_t element = w + JODY_HASH_CONSTANT;
+	const jodyhash_t element2 = JH_ROR(w) ^ jh_s_constant;
+
+	h += element;
+	h ^= element2;
+	h = JH_ROL2(h);
+	return h + element;
+}
+
+
+/* Portable reference for the wide variant's accumulator loop */
+static void jody_block_hash_wide_scalar(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks)
+{
+	jodyhash_t a[JODY_HASH_WIDE_LANES], element;
+
+	memcpy(a, acc, sizeof(a));
+	for (size_t i = 0; i < blocks; i++) {
+		for (int j = 0; j < JODY_HASH_WIDE_LANES; j++) {
+			memcpy(&element, data, sizeof(jodyhash_t));
+			a[j] = jh_wide_step(a[j], element);
+			data++;
+		}
+	}
+	memcpy(acc, a, sizeof(a));
+	return;
+}
+
+
+/* Wide variant (JODY_HASH_WIDE_VERSION): word i of the data goes to
+ * accumulator i % JODY_HASH_WIDE_LANES, so the accumulators are independent
+ * and stay in vector registers. The accumulators and the data length are
+ * then hashed in order into the final hash. The result does not depend on
+ * which kernel computed it, but it is NOT a v7 hash and, unlike
+ * jody_block_hash(), hashing in pieces is not the same as hashing the
+ * whole thing at once. *hash is the seed (normally zero). */
+extern int jody_block_hash_wide(const jodyhash_t *data, jodyhash_t *hash, const size_t count)
+{
+	jodyhash_t acc[JODY_HASH_WIDE_LANES];
+	jodyhash_t element = 0;
+	const struct jody_hash_kernel *kernel;
+	size_t blocks, words, i;
+
+	if (unlikely(data == NULL && count != 0)) return 1;
+	kernel = jh_get_kernel();
+
+	for (i = 0; i < JODY_HASH_WIDE_LANES; i++) acc[i] = *hash + (jodyhash_t)i * JODY_HASH_CONSTANT;
+
+	blocks = count / (sizeof(jodyhash_t) * JODY_HASH_WIDE_LANES);
+	if (blocks != 0) {
+		kernel->wide(data, acc, blocks);
+		data += blocks * JODY_HASH_WIDE_LANES;
+	}
+
+	/* Leftover words, then the zero-padded partial word, go to the
+	 * accumulators in order; nothing past the end of the data is read */
+	words = count / sizeof(jodyhash_t) - blocks * JODY_HASH_WIDE_LANES;
+	for (i = 0; i < words; i++) {
+		memcpy(&element, data + i, sizeof(jodyhash_t));
+		acc[i] = jh_wide_step(acc[i], element);
+	}
+	if ((count & (sizeof(jodyhash_t) - 1)) != 0) {
+		element = 0;
+		memcpy(&element, data + words, count & (sizeof(jodyhash_t) - 1));
+		acc[words] = jh_wide_step(acc[words], element);
+	}
+
+	/* Fold the accumulators and the length in a fixed order */
+	for (i = 0; i < JODY_HASH_WIDE_LANES; i++) *hash = jh_wide_step(*hash, acc[i]);
+	*hash = jh_wide_step(*hash, (jodyhash_t)count);
+	return 0;
+}
+
+
+/* 128-bit variant (JODY_HASH128_VERSION): hash[0] gets exactly what
+ * jody_block_hash() would give and hash[1] gets the second lane. Both
+ * lanes are updated from each word as it is read, so the data is only
+ * read once, and blocks can be chained like with jody_block_hash(). */
+extern int jody_block_hash128(const jodyhash_t *data, jodyhash_t *hash, const size_t count)
+{
+	jodyhash_t a, b, element, element2, b_element, b_element2;
+	const struct jody_hash_kernel *kernel;
+	size_t length;
+
+	if (unlikely(count == 0)) return 0;
+	kernel = jh_get_kernel();
+
+	if (count >= 32 && kernel->block128 != NULL) {
+		if (kernel->block128(&data, hash, count, &length) != 0) return 1;
+	} else length = count / sizeof(jodyhash_t);
+	a = hash[0];
+	b = hash[1];
+
+	for (; length > 0; length--) {
+		memcpy(&element, data, sizeof(jodyhash_t));
+		b_element = element;
+		element2 = JH_ROR(element) ^ jh_s_constant;
+		element += JODY_HASH_CONSTANT;
+		b_element2 = JH128_ROR(b_element) ^ JODY_HASH128_CONSTANT_ROR2;
+		b_element += JODY_HASH128_CONSTANT;
+		a += element;
+		b += b_element;
+		a ^= element2;
+		b ^= b_element2;
+		a = JH_ROL2(a);
+		b = JH128_ROL2(b);
+		a += element;
+		b += b_element;
+		data++;
+	}
+
+	length = count & (sizeof(jodyhash_t) - 1);
+	if (length) {
+		element = *data & tail_mask[length];
+		b_element = element;
+		element2 = JH_ROR(element) ^ jh_s_constant;
+		element += JODY_HASH_CONSTANT;
+		b_element2 = JH128_ROR(b_element) ^ JODY_HASH128_CONSTANT_ROR2;
+		b_element += JODY_HASH128_CONSTANT;
+		a += element;
+		b += b_element;
+		a ^= element2;
+		b ^= b_element2;
+		a = JH_ROL2(a);
+		b = JH128_ROL2(b);
+		a += element2;
+		b += b_element2;
+	}
+
+	hash[0] = a;
+	hash[1] = b;
+	return 0;
+}
+
+
+/* Portable first-difference search; whole words first, then bytes */
+static size_t jody_memdiff_scalar(const unsigned char *a, const unsigned char *b, const size_t count)
+{
+	uint64_t x, y;
+	size_t i = 0;
+
+	for (; i + sizeof(uint64_t) <= count; i += sizeof(uint64_t)) {
+		memcpy(&x, a + i, sizeof(uint64_t));
+		memcpy(&y, b + i, sizeof(uint64_t));
+		if (x != y) break;
+	}
+	for (; i < count; i++) if (a[i] != b[i]) break;
+	return i;
+}
+
+
+/* Length of the all-zero prefix (count if every byte is zero) */
+static size_t jody_zero_span_scalar(const unsigned char *data, const size_t count)
+{
+	uint64_t x;
+	size_t i = 0;
+
+	for (; i + sizeof(uint64_t) <= count; i += sizeof(uint64_t)) {
+		memcpy(&x, data + i, sizeof(uint64_t));
+		if (x != 0) break;
+	}
+	for (; i < count; i++) if (data[i] != 0) break;
+	return i;
+}
+
+/* Offset of the first byte that differs between two buffers, or count if
+ * they are identical; uses the selected kernel's compare loop */
+extern size_t jody_memdiff(const void *a, const void *b, const size_t count)
+{
+	return jh_get_kernel()->diff((const unsigned char *)a, (const unsigned char *)b, count);
+}
+
+
+/* Number of zero bytes at the start of a buffer (count if all are zero) */
+extern size_t jody_zero_span(const void *data, const size_t count)
+{
+	return jh_get_kernel()->zero((const unsigned char *)data, count);
+}
@@ -20,6 +20,27 @@ extern "C" {
 /* Version increments when algorithm changes incompatibly */
 #define JODY_HASH_VERSION 7
 
+/* Chunked tree mode is a separate hash with its own version; the chunk
+ * size is part of the tree format */
+#define JODY_HASH_TREE_VERSION 1
+#define JODY_HASH_TREE_CHUNK 1048576
+
+/* The lane-parallel "wide" variant is also separate; it interleaves the
+ * data over this many accumulators no matter what kernel runs it */
+#define JODY_HASH_WIDE_VERSION 1
+#define JODY_HASH_WIDE_LANES 8
+
+/* Content-defined chunk boundaries (gear table and masks) are versioned
+ * too; chunk hashes themselves are ordinary v7 hashes */
+#define JODY_HASH_CDC_VERSION 1
+
+/* Sampled quick fingerprints (which ranges are hashed) */
+#define JODY_HASH_SAMPLE_VERSION 1
+
+/* 128-bit variant: the first half is exactly the normal hash and the
+ * second half is a decorrelated lane with its own version */
+#define JODY_HASH128_VERSION 1
+
 /* DO NOT modify shifts/contants unless you know what you're doing. They were
  * chosen after lots of testing. Changes will likely cause lots of hash
  * collisions. The vectorized versions also use constants that have this value
@@ -91,8 +112,39 @@ static const jodyhash_t tail_mask[] = {
 #define JH_ROL2(a) (jodyhash_t)(a << JH_SHIFT2 | (a >> ((sizeof(jodyhash_t) * 8) - JH_SHIFT2)))
 #define JH_ROR2(a) (jodyhash_t)(a >> JH_SHIFT2 | (a << ((sizeof(jodyhash_t) * 8) - JH_SHIFT2)))
 
+/* Second lane of the 128-bit variant: the same kind of round, but with a
+ * different constant and rotation amounts that share no factor with the
+ * first lane's, so data that collides in one lane rarely collides in both */
+#define JODY_HASH128_CONSTANT       0x9c5f2b6e3a1d8047ULL
+#define JODY_HASH128_SHIFT          23
+#define JODY_HASH128_SHIFT2         37
+#define JODY_HASH128_CONSTANT_ROR2  (JODY_HASH128_CONSTANT >> JODY_HASH128_SHIFT2 | (JODY_HASH128_CONSTANT << (64 - JODY_HASH128_SHIFT2)))
+#define JH128_ROR(a)  (uint64_t)((a >> JODY_HASH128_SHIFT) | (a << (64 - JODY_HASH128_SHIFT)))
+#define JH128_ROL2(a) (uint64_t)((a << JODY_HASH128_SHIFT2) | (a >> (64 - JODY_HASH128_SHIFT2)))
+
+
+/* Kernel selection for jody_block_hash(); AUTO picks the best one available.
+ * The JODY_HASH_KERNEL environment variable ("scalar", "sse2", "avx2",
+ * "avx512", "vec") overrides the automatic choice when the library is loaded.
+ * VEC is the portable vector-extension kernel; it is the automatic choice
+ * only when no CPU-specific kernel can be used. */
+#define JODY_HASH_KERNEL_AUTO   0
+#define JODY_HASH_KERNEL_SCALAR 1
+#define JODY_HASH_KERNEL_SSE2   2
+#define JODY_HASH_KERNEL_AVX2   3
+#define JODY_HASH_KERNEL_AVX512 4
+#define JODY_HASH_KERNEL_VEC    5
+#define JODY_HASH_KERNEL_MAX    5
 
-extern int jody_block_hash(jodyhash_t *data, jodyhash_t *hash, const size_t count);
+extern int jody_block_hash(const jodyhash_t *data, jodyhash_t *hash, const size_t count);
+extern int jody_block_hash_multi(const jodyhash_t * const *data, jodyhash_t *hash, const size_t buffers, const size_t count);
+extern int jody_block_hash_wide(const jodyhash_t *data, jodyhash_t *hash, const size_t count);
+extern int jody_block_hash128(const jodyhash_t *data, jodyhash_t *hash, const size_t count);
+extern void jody_block_hash_zeroes(jodyhash_t *hash, uint64_t words);
+extern int jody_hash_set_kernel(const int kernel);
+extern int jody_hash_get_kernel(void);
+extern size_t jody_memdiff(const void *a, const void *b, const size_t count);
+extern size_t jody_zero_span(const void *data, const size_t count);
 
 #ifdef __cplusplus
 }
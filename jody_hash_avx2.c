@@ -17,10 +17,10 @@
 
 #ifndef NO_AVX2
 
-int jody_block_hash_avx2(jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
+int jody_block_hash_avx2(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
 {
-	size_t vec_allocsize;
-	__m256i *aligned_data;
+	size_t vec_size;
+	const __m256i *vec_data = (const __m256i *)*data;
 	/* Regs used in groups of 3; 1=ROR/XOR work, 2=temp, 3=data+constant */
 	__m256i vx1, vx2, vx3;
 	__m256i avx_const, avx_ror2;
@@ -29,18 +29,13 @@ int jody_block_hash_avx2(jodyhash_t **data, jodyhash_t *hash, const size_t count
 	avx_const = _mm256_load_si256(&vec_constant.v256);
 	avx_ror2  = _mm256_load_si256(&vec_constant_ror2.v256);
 
-	/* How much memory do we need to align the data? */
-	vec_allocsize = count & 0xffffffffffffffe0U;
-	/* Only alloc/copy if not already aligned */
-	if (((uintptr_t)*data & (uintptr_t)0x1fULL) != 0) {
-		aligned_data  = (__m256i *)aligned_alloc(32, vec_allocsize);
-		if (!aligned_data) return 1;
-		memcpy(aligned_data, *data, vec_allocsize);
-	} else aligned_data = (__m256i *)*data;
+	/* Unaligned loads are as fast as aligned ones on AVX2 hardware when the
+	 * data happens to be aligned, so the data is never copied or aligned */
+	vec_size = count & 0xffffffffffffffe0U;
 
-	for (size_t i = 0; i < (vec_allocsize / 32); i++) {
-		vx1  = _mm256_load_si256(&aligned_data[i]);
-		vx3  = _mm256_load_si256(&aligned_data[i]);
+	for (size_t i = 0; i < (vec_size / 32); i++) {
+		vx1  = _mm256_loadu_si256(&vec_data[i]);
+		vx3  = vx1;
 
 		/* "element2" gets RORed (two logical shifts ORed together) */
 		vx1  = _mm256_srli_epi64(vx1, JODY_HASH_SHIFT);
@@ -79,9 +74,179 @@ int jody_block_hash_avx2(jodyhash_t **data, jodyhash_t *hash, const size_t count
 			*hash += ep1;
 		}  // End of hash finish loop
 	}  // End of main AVX for loop
-	*data += vec_allocsize / sizeof(jodyhash_t);
-	if (((uintptr_t)*data & (uintptr_t)0x1fULL) != 0) ALIGNED_FREE(aligned_data);
-	*length = (count - vec_allocsize) / sizeof(jodyhash_t);
+	*data += vec_size / sizeof(jodyhash_t);
+	*length = (count - vec_size) / sizeof(jodyhash_t);
+	return 0;
+}
+
+
+/* Advance four independent hashes by one word each (one per 64-bit lane) */
+#define AVX2_STEP(h, w) { \
+	vx1 = _mm256_or_si256(_mm256_srli_epi64(w, JODY_HASH_SHIFT), _mm256_slli_epi64(w, (64 - JODY_HASH_SHIFT))); \
+	vx1 = _mm256_xor_si256(vx1, avx_ror2); \
+	vx3 = _mm256_add_epi64(w, avx_const); \
+	h = _mm256_add_epi64(h, vx3); \
+	h = _mm256_xor_si256(h, vx1); \
+	h = _mm256_or_si256(_mm256_slli_epi64(h, JH_SHIFT2), _mm256_srli_epi64(h, (64 - JH_SHIFT2))); \
+	h = _mm256_add_epi64(h, vx3); \
+}
+
+/* Hash four equal-sized buffers at once, each in its own lane; returns the
+ * number of bytes hashed from each buffer (the rest is left to the caller) */
+size_t jody_block_hash_multi_avx2(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count)
+{
+	size_t vec_size;
+	const __m256i *d0 = (const __m256i *)data[0];
+	const __m256i *d1 = (const __m256i *)data[1];
+	const __m256i *d2 = (const __m256i *)data[2];
+	const __m256i *d3 = (const __m256i *)data[3];
+	__m256i vh, vx1, vx3;
+	/* Four words from each buffer, then the same words transposed by lane */
+	__m256i r0, r1, r2, r3, t0, t1, t2, t3;
+	__m256i avx_const, avx_ror2;
+
+	avx_const = _mm256_load_si256(&vec_constant.v256);
+	avx_ror2  = _mm256_load_si256(&vec_constant_ror2.v256);
+	vh = _mm256_loadu_si256((const __m256i *)hash);
+
+	vec_size = count & 0xffffffffffffffe0U;
+
+	for (size_t i = 0; i < (vec_size / 32); i++) {
+		r0 = _mm256_loadu_si256(&d0[i]);
+		r1 = _mm256_loadu_si256(&d1[i]);
+		r2 = _mm256_loadu_si256(&d2[i]);
+		r3 = _mm256_loadu_si256(&d3[i]);
+
+		t0 = _mm256_unpacklo_epi64(r0, r1);
+		t1 = _mm256_unpackhi_epi64(r0, r1);
+		t2 = _mm256_unpacklo_epi64(r2, r3);
+		t3 = _mm256_unpackhi_epi64(r2, r3);
+		r0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+		r1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+		r2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+		r3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+
+		AVX2_STEP(vh, r0);
+		AVX2_STEP(vh, r1);
+		AVX2_STEP(vh, r2);
+		AVX2_STEP(vh, r3);
+	}
+
+	_mm256_storeu_si256((__m256i *)hash, vh);
+	return vec_size;
+}
+
+
+/* Wide variant: eight interleaved accumulators in two registers, each
+ * taking the next four words of every 64-byte block */
+void jody_block_hash_wide_avx2(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks)
+{
+	const __m256i *vec_data = (const __m256i *)data;
+	__m256i h0, h1, vx1, vx3;
+	__m256i avx_const, avx_ror2;
+
+	avx_const = _mm256_load_si256(&vec_constant.v256);
+	avx_ror2  = _mm256_load_si256(&vec_constant_ror2.v256);
+	h0 = _mm256_loadu_si256((const __m256i *)acc);
+	h1 = _mm256_loadu_si256((const __m256i *)acc + 1);
+
+	for (size_t i = 0; i < blocks; i++) {
+		AVX2_STEP(h0, _mm256_loadu_si256(&vec_data[i * 2]));
+		AVX2_STEP(h1, _mm256_loadu_si256(&vec_data[i * 2 + 1]));
+	}
+
+	_mm256_storeu_si256((__m256i *)acc, h0);
+	_mm256_storeu_si256((__m256i *)acc + 1, h1);
+	return;
+}
+
+
+/* Offset of the first byte that differs, or count if the buffers match */
+size_t jody_memdiff_avx2(const unsigned char *a, const unsigned char *b, const size_t count)
+{
+	__m256i e0, e1;
+	unsigned int mask;
+	size_t i = 0;
+
+	for (; i + 64 <= count; i += 64) {
+		e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(const void *)(a + i)), _mm256_loadu_si256((const __m256i *)(const void *)(b + i)));
+		e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(const void *)(a + i + 32)), _mm256_loadu_si256((const __m256i *)(const void *)(b + i + 32)));
+		if ((unsigned int)_mm256_movemask_epi8(_mm256_and_si256(e0, e1)) != 0xffffffffU) break;
+	}
+	for (; i + 32 <= count; i += 32) {
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(const void *)(a + i)),
+				_mm256_loadu_si256((const __m256i *)(const void *)(b + i))));
+		if (mask != 0xffffffffU) return i + (size_t)__builtin_ctz(~mask);
+	}
+	for (; i < count; i++) if (a[i] != b[i]) break;
+	return i;
+}
+
+
+/* Length of the all-zero prefix (count if every byte is zero); whole
+ * blocks are checked with one VPTEST of the OR of four loads */
+size_t jody_zero_span_avx2(const unsigned char *data, const size_t count)
+{
+	__m256i v;
+	unsigned int mask;
+	size_t i = 0;
+
+	for (; i + 128 <= count; i += 128) {
+		v = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256((const __m256i *)(const void *)(data + i)), _mm256_loadu_si256((const __m256i *)(const void *)(data + i + 32))),
+				_mm256_or_si256(_mm256_loadu_si256((const __m256i *)(const void *)(data + i + 64)), _mm256_loadu_si256((const __m256i *)(const void *)(data + i + 96))));
+		if (!_mm256_testz_si256(v, v)) break;
+	}
+	for (; i + 32 <= count; i += 32) {
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(const void *)(data + i)), _mm256_setzero_si256()));
+		if (mask != 0xffffffffU) return i + (size_t)__builtin_ctz(~mask);
+	}
+	for (; i < count; i++) if (data[i] != 0) break;
+	return i;
+}
+
+/* 128-bit variant: both lanes' per-word values are computed four words at
+ * a time; the two serial hash chains are then interleaved in scalar code */
+int jody_block_hash128_avx2(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
+{
+	size_t vec_size;
+	const __m256i *vec_data = (const __m256i *)*data;
+	__m256i w, a1, a3, b1, b3;
+	__m256i avx_const, avx_ror2, b_const, b_ror2;
+	union UINT256 ea1, ea2, eb1, eb2;
+	jodyhash_t a = hash[0], b = hash[1];
+
+	avx_const = _mm256_load_si256(&vec_constant.v256);
+	avx_ror2  = _mm256_load_si256(&vec_constant_ror2.v256);
+	b_const = _mm256_set1_epi64x((long long)JODY_HASH128_CONSTANT);
+	b_ror2  = _mm256_set1_epi64x((long long)JODY_HASH128_CONSTANT_ROR2);
+
+	vec_size = count & 0xffffffffffffffe0U;
+
+	for (size_t i = 0; i < (vec_size / 32); i++) {
+		w  = _mm256_loadu_si256(&vec_data[i]);
+		a1 = _mm256_xor_si256(_mm256_or_si256(_mm256_srli_epi64(w, JODY_HASH_SHIFT), _mm256_slli_epi64(w, (64 - JODY_HASH_SHIFT))), avx_ror2);
+		a3 = _mm256_add_epi64(w, avx_const);
+		b1 = _mm256_xor_si256(_mm256_or_si256(_mm256_srli_epi64(w, JODY_HASH128_SHIFT), _mm256_slli_epi64(w, (64 - JODY_HASH128_SHIFT))), b_ror2);
+		b3 = _mm256_add_epi64(w, b_const);
+		_mm256_store_si256(&ea1.v256, a3);
+		_mm256_store_si256(&ea2.v256, a1);
+		_mm256_store_si256(&eb1.v256, b3);
+		_mm256_store_si256(&eb2.v256, b1);
+		for (int j = 0; j < 4; j++) {
+			a += ea1.v64[j];
+			b += eb1.v64[j];
+			a ^= ea2.v64[j];
+			b ^= eb2.v64[j];
+			a = JH_ROL2(a);
+			b = JH128_ROL2(b);
+			a += ea1.v64[j];
+			b += eb1.v64[j];
+		}
+	}
+	hash[0] = a;
+	hash[1] = b;
+	*data += vec_size / sizeof(jodyhash_t);
+	*length = (count - vec_size) / sizeof(jodyhash_t);
 	return 0;
 }
 
@@ -0,0 +1,243 @@
+/* Jody Bruchon's fast hashing function
+ *
+ * This function was written to generate a fast hash that also has a
+ * fairly low collision rate. The collision rate is much higher than
+ * a secure hash algorithm, but the calculation is drastically simpler
+ * and faster.
+ *
+ * Copyright (C) 2014-2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* GCC's own AVX-512 headers trip this warning with their "undefined" values */
+#if defined __GNUC__ && !defined __clang__
+ #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "jody_hash.h"
+#include "jody_hash_simd.h"
+
+#ifndef NO_AVX512
+
+union UINT512 {
+	__m512i  v512;
+	uint64_t v64[8];
+};
+
+int jody_block_hash_avx512(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
+{
+	size_t vec_size;
+	const __m512i *vec_data = (const __m512i *)*data;
+	/* 1=ROR/XOR work, 3=data+constant (same roles as the AVX2 kernel) */
+	__m512i vx1, vx3;
+	__m512i zmm_const, zmm_ror2;
+	union UINT512 ep1, ep2;
+	jodyhash_t h = *hash;
+
+	/* Constants preload */
+	zmm_const = _mm512_set1_epi64((long long)JODY_HASH_CONSTANT);
+	zmm_ror2  = _mm512_set1_epi64((long long)JODY_HASH_CONSTANT_ROR2);
+
+	vec_size = count & 0xffffffffffffffc0U;
+
+	for (size_t i = 0; i < (vec_size / 64); i++) {
+		vx3 = _mm512_loadu_si512(&vec_data[i]);
+
+		/* "element2" gets RORed with a native rotate and XORed */
+		vx1 = _mm512_ror_epi64(vx3, JODY_HASH_SHIFT);
+		vx1 = _mm512_xor_si512(vx1, zmm_ror2);
+
+		/* Add the constant to "element" */
+		vx3 = _mm512_add_epi64(vx3, zmm_const);
+
+		/* Perform the rest of the hash */
+		_mm512_store_si512(&ep1.v512, vx3);
+		_mm512_store_si512(&ep2.v512, vx1);
+		for (int j = 0; j < 8; j++) {
+			h += ep1.v64[j];
+			h ^= ep2.v64[j];
+			h = JH_ROL2(h);
+			h += ep1.v64[j];
+		}
+	}
+	*hash = h;
+	*data += vec_size / sizeof(jodyhash_t);
+	*length = (count - vec_size) / sizeof(jodyhash_t);
+	return 0;
+}
+
+
+/* Advance eight independent hashes by one word each (one per 64-bit lane) */
+#define AVX512_STEP(h, w) { \
+	vx1 = _mm512_xor_si512(_mm512_ror_epi64(w, JODY_HASH_SHIFT), zmm_ror2); \
+	vx3 = _mm512_add_epi64(w, zmm_const); \
+	h = _mm512_add_epi64(h, vx3); \
+	h = _mm512_xor_si512(h, vx1); \
+	h = _mm512_rol_epi64(h, JH_SHIFT2); \
+	h = _mm512_add_epi64(h, vx3); \
+}
+
+/* Hash eight equal-sized buffers at once, each in its own lane; returns the
+ * number of bytes hashed from each buffer (the rest is left to the caller) */
+size_t jody_block_hash_multi_avx512(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count)
+{
+	size_t vec_size;
+	__m512i vh, vx1, vx3;
+	/* Eight words from each buffer, then the same words transposed by lane */
+	__m512i r[8], t[8], u[4];
+	__m512i zmm_const, zmm_ror2;
+
+	zmm_const = _mm512_set1_epi64((long long)JODY_HASH_CONSTANT);
+	zmm_ror2  = _mm512_set1_epi64((long long)JODY_HASH_CONSTANT_ROR2);
+	vh = _mm512_loadu_si512(hash);
+
+	vec_size = count & 0xffffffffffffffc0U;
+
+	for (size_t i = 0; i < (vec_size / 64); i++) {
+		for (int j = 0; j < 8; j++) r[j] = _mm512_loadu_si512((const __m512i *)data[j] + i);
+
+		/* 8x8 transpose: pair up words, then 128-bit blocks */
+		for (int j = 0; j < 8; j += 2) {
+			t[j]     = _mm512_unpacklo_epi64(r[j], r[j + 1]);
+			t[j + 1] = _mm512_unpackhi_epi64(r[j], r[j + 1]);
+		}
+		u[0] = _mm512_shuffle_i64x2(t[0], t[2], _MM_SHUFFLE(2, 0, 2, 0));
+		u[1] = _mm512_shuffle_i64x2(t[4], t[6], _MM_SHUFFLE(2, 0, 2, 0));
+		u[2] = _mm512_shuffle_i64x2(t[0], t[2], _MM_SHUFFLE(3, 1, 3, 1));
+		u[3] = _mm512_shuffle_i64x2(t[4], t[6], _MM_SHUFFLE(3, 1, 3, 1));
+		r[0] = _mm512_shuffle_i64x2(u[0], u[1], _MM_SHUFFLE(2, 0, 2, 0));
+		r[4] = _mm512_shuffle_i64x2(u[0], u[1], _MM_SHUFFLE(3, 1, 3, 1));
+		r[2] = _mm512_shuffle_i64x2(u[2], u[3], _MM_SHUFFLE(2, 0, 2, 0));
+		r[6] = _mm512_shuffle_i64x2(u[2], u[3], _MM_SHUFFLE(3, 1, 3, 1));
+		u[0] = _mm512_shuffle_i64x2(t[1], t[3], _MM_SHUFFLE(2, 0, 2, 0));
+		u[1] = _mm512_shuffle_i64x2(t[5], t[7], _MM_SHUFFLE(2, 0, 2, 0));
+		u[2] = _mm512_shuffle_i64x2(t[1], t[3], _MM_SHUFFLE(3, 1, 3, 1));
+		u[3] = _mm512_shuffle_i64x2(t[5], t[7], _MM_SHUFFLE(3, 1, 3, 1));
+		r[1] = _mm512_shuffle_i64x2(u[0], u[1], _MM_SHUFFLE(2, 0, 2, 0));
+		r[5] = _mm512_shuffle_i64x2(u[0], u[1], _MM_SHUFFLE(3, 1, 3, 1));
+		r[3] = _mm512_shuffle_i64x2(u[2], u[3], _MM_SHUFFLE(2, 0, 2, 0));
+		r[7] = _mm512_shuffle_i64x2(u[2], u[3], _MM_SHUFFLE(3, 1, 3, 1));
+
+		for (int j = 0; j < 8; j++) AVX512_STEP(vh, r[j]);
+	}
+
+	_mm512_storeu_si512(hash, vh);
+	return vec_size;
+}
+
+
+/* Wide variant: all eight interleaved accumulators fit in one register */
+void jody_block_hash_wide_avx512(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks)
+{
+	const __m512i *vec_data = (const __m512i *)data;
+	__m512i vh, vx1, vx3;
+	__m512i zmm_const, zmm_ror2;
+
+	zmm_const = _mm512_set1_epi64((long long)JODY_HASH_CONSTANT);
+	zmm_ror2  = _mm512_set1_epi64((long long)JODY_HASH_CONSTANT_ROR2);
+	vh = _mm512_loadu_si512(acc);
+
+	for (size_t i = 0; i < blocks; i++) AVX512_STEP(vh, _mm512_loadu_si512(&vec_data[i]));
+
+	_mm512_storeu_si512(acc, vh);
+	return;
+}
+
+
+/* Offset of the first byte that differs, or count if the buffers match
+ * AVX-512F has no byte compare, so 64-bit lanes are compared and the byte
+ * is found in the first differing lane */
+size_t jody_memdiff_avx512(const unsigned char *a, const unsigned char *b, const size_t count)
+{
+	uint64_t x, y;
+	unsigned int mask;
+	size_t i = 0, lane;
+
+	for (; i + 64 <= count; i += 64) {
+		mask = (unsigned int)_mm512_cmpneq_epi64_mask(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+		if (mask != 0) {
+			lane = i + (size_t)__builtin_ctz(mask) * 8;
+			memcpy(&x, a + lane, 8);
+			memcpy(&y, b + lane, 8);
+			/* x86 is little-endian: the lowest set bit is the first byte */
+			return lane + (size_t)__builtin_ctzll(x ^ y) / 8;
+		}
+	}
+	for (; i < count; i++) if (a[i] != b[i]) break;
+	return i;
+}
+
+
+/* Length of the all-zero prefix (count if every byte is zero) */
+size_t jody_zero_span_avx512(const unsigned char *data, const size_t count)
+{
+	__m512i v;
+	uint64_t x;
+	unsigned int mask;
+	size_t i = 0, lane;
+
+	for (; i + 128 <= count; i += 128) {
+		v = _mm512_or_si512(_mm512_loadu_si512(data + i), _mm512_loadu_si512(data + i + 64));
+		if (_mm512_test_epi64_mask(v, v) != 0) break;
+	}
+	for (; i + 64 <= count; i += 64) {
+		v = _mm512_loadu_si512(data + i);
+		mask = (unsigned int)_mm512_test_epi64_mask(v, v);
+		if (mask != 0) {
+			lane = i + (size_t)__builtin_ctz(mask) * 8;
+			memcpy(&x, data + lane, 8);
+			/* x86 is little-endian: the lowest set bit is the first byte */
+			return lane + (size_t)__builtin_ctzll(x) / 8;
+		}
+	}
+	for (; i < count; i++) if (data[i] != 0) break;
+	return i;
+}
+
+/* 128-bit variant: both lanes' per-word values are computed eight words
+ * at a time; the two serial hash chains are then interleaved */
+int jody_block_hash128_avx512(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
+{
+	size_t vec_size;
+	const __m512i *vec_data = (const __m512i *)*data;
+	__m512i w;
+	__m512i zmm_const, zmm_ror2, b_const, b_ror2;
+	union UINT512 ea1, ea2, eb1, eb2;
+	jodyhash_t a = hash[0], b = hash[1];
+
+	zmm_const = _mm512_set1_epi64((long long)JODY_HASH_CONSTANT);
+	zmm_ror2  = _mm512_set1_epi64((long long)JODY_HASH_CONSTANT_ROR2);
+	b_const = _mm512_set1_epi64((long long)JODY_HASH128_CONSTANT);
+	b_ror2  = _mm512_set1_epi64((long long)JODY_HASH128_CONSTANT_ROR2);
+
+	vec_size = count & 0xffffffffffffffc0U;
+
+	for (size_t i = 0; i < (vec_size / 64); i++) {
+		w = _mm512_loadu_si512(&vec_data[i]);
+		_mm512_store_si512(&ea1.v512, _mm512_add_epi64(w, zmm_const));
+		_mm512_store_si512(&ea2.v512, _mm512_xor_si512(_mm512_ror_epi64(w, JODY_HASH_SHIFT), zmm_ror2));
+		_mm512_store_si512(&eb1.v512, _mm512_add_epi64(w, b_const));
+		_mm512_store_si512(&eb2.v512, _mm512_xor_si512(_mm512_ror_epi64(w, JODY_HASH128_SHIFT), b_ror2));
+		for (int j = 0; j < 8; j++) {
+			a += ea1.v64[j];
+			b += eb1.v64[j];
+			a ^= ea2.v64[j];
+			b ^= eb2.v64[j];
+			a = JH_ROL2(a);
+			b = JH128_ROL2(b);
+			a += ea1.v64[j];
+			b += eb1.v64[j];
+		}
+	}
+	hash[0] = a;
+	hash[1] = b;
+	*data += vec_size / sizeof(jodyhash_t);
+	*length = (count - vec_size) / sizeof(jodyhash_t);
+	return 0;
+}
+
+#endif /* NO_AVX512 */
@@ -11,13 +11,16 @@ extern "C" {
 #include "jody_hash.h"
 
 /* Disable SIMD if not 64-bit width or not 64-bit x86 code */
-#if JODY_HASH_WIDTH != 64 || !defined __x86_64__ || SIZE_MAX == 0xffffffff || (defined NO_SSE2 && defined NO_AVX2)
+#if JODY_HASH_WIDTH != 64 || !defined __x86_64__ || SIZE_MAX == 0xffffffff || (defined NO_SSE2 && defined NO_AVX2 && defined NO_AVX512)
  #ifndef NO_SSE2
   #define NO_SSE2
  #endif
  #ifndef NO_AVX2
   #define NO_AVX2
  #endif
+ #ifndef NO_AVX512
+  #define NO_AVX512
+ #endif
  #ifndef NO_SIMD
   #define NO_SIMD
  #endif
@@ -28,16 +31,20 @@ extern "C" {
  #if defined _MSC_VER || defined _WIN32 || defined __MINGW32__
   /* Microsoft C/C++-compatible compiler */
   #include <intrin.h>
-  #define aligned_alloc(a,b) _aligned_malloc(b,a)
-  #define ALIGNED_FREE(a) _aligned_free(a)
  #elif (defined __GNUC__  || defined __clang__ ) && (defined __x86_64__  || defined __i386__ )
   /* GCC or Clang targeting x86/x86-64 */
   #include <x86intrin.h>
-  #define ALIGNED_FREE(a) free(a)
  #endif
 #endif /* !NO_SIMD */
 
-#if !defined NO_SSE2 || !defined NO_AVX2
+/* The portable vector kernel only needs GCC/Clang vector extensions */
+#if JODY_HASH_WIDTH != 64 || !(defined __GNUC__ || defined __clang__)
+ #ifndef NO_VEC
+  #define NO_VEC
+ #endif
+#endif
+
+#if !defined NO_SSE2 || !defined NO_AVX2 || !defined NO_AVX512
 union UINT256 {
 	__m256i  v256;
 	__m128i  v128[2];
@@ -47,8 +54,53 @@ union UINT256 {
 extern const union UINT256 vec_constant, vec_constant_ror2;
 #endif
 
-extern int jody_block_hash_avx2(jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
-extern int jody_block_hash_sse2(jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+/* Most buffers any multi-buffer kernel hashes at once */
+#define JODY_HASH_MAX_LANES 8
+
+/* block: vectorized part of a block hash; scalar code finishes *length words
+ * multi: hashes 'lanes' buffers in parallel, returning the byte count done
+ * wide: runs the wide variant's accumulators over whole 64-byte blocks
+ * diff: returns the offset of the first differing byte (count if none)
+ * zero: returns the offset of the first nonzero byte (count if none)
+ * block128: like block, but for both lanes of the 128-bit variant */
+struct jody_hash_kernel {
+	const char *name;
+	int (*block)(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+	size_t (*multi)(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count);
+	void (*wide)(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks);
+	size_t (*diff)(const unsigned char *a, const unsigned char *b, const size_t count);
+	size_t (*zero)(const unsigned char *data, const size_t count);
+	int (*block128)(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+	size_t lanes;
+};
+
+/* Set once at kernel selection time: nonzero if the CPU supports AVX */
+extern int jody_hash_cpu_avx;
+
+extern int jody_block_hash_avx2(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+extern int jody_block_hash_sse2(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+extern int jody_block_hash_avx512(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+extern size_t jody_block_hash_multi_avx512(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count);
+extern size_t jody_block_hash_multi_avx2(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count);
+extern size_t jody_block_hash_multi_sse2(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count);
+extern void jody_block_hash_wide_avx512(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks);
+extern void jody_block_hash_wide_avx2(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks);
+extern void jody_block_hash_wide_sse2(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks);
+extern int jody_block_hash128_avx512(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+extern int jody_block_hash128_avx2(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+extern int jody_block_hash128_sse2(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+extern size_t jody_memdiff_avx512(const unsigned char *a, const unsigned char *b, const size_t count);
+extern size_t jody_zero_span_avx512(const unsigned char *data, const size_t count);
+extern size_t jody_memdiff_avx2(const unsigned char *a, const unsigned char *b, const size_t count);
+extern size_t jody_zero_span_avx2(const unsigned char *data, const size_t count);
+extern size_t jody_memdiff_sse2(const unsigned char *a, const unsigned char *b, const size_t count);
+extern size_t jody_zero_span_sse2(const unsigned char *data, const size_t count);
+extern int jody_block_hash_vec(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
+extern size_t jody_block_hash_multi_vec(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count);
+extern void jody_block_hash_wide_vec(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks);
+extern size_t jody_memdiff_vec(const unsigned char *a, const unsigned char *b, const size_t count);
+extern size_t jody_zero_span_vec(const unsigned char *data, const size_t count);
+extern int jody_block_hash128_vec(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length);
 
 #ifdef __cplusplus
 }
@@ -17,17 +17,17 @@
 
 #ifndef NO_SSE2
 
-int jody_block_hash_sse2(jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
+int jody_block_hash_sse2(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
 {
-	size_t vec_allocsize;
-	__m128i *aligned_data;
+	size_t vec_size;
+	const __m128i *vec_data = (const __m128i *)*data;
 	__m128i v1, v2, v3, v4, v5, v6;
 	__m128 vzero;
 	__m128i vec_const, vec_ror2;
 
 #if defined __GNUC__ || defined __clang__
-	__builtin_cpu_init ();
-	if (__builtin_cpu_supports ("avx")) {
+	/* Avoid AVX-SSE transition penalties; AVX support is probed only once */
+	if (jody_hash_cpu_avx) {
 		asm volatile ("vzeroall" : : :
 			"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
 			"ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15");
@@ -39,21 +39,15 @@ int jody_block_hash_sse2(jodyhash_t **data, jodyhash_t *hash, const size_t count
 	vec_ror2  = _mm_load_si128(&vec_constant_ror2.v128[0]);
 	vzero = _mm_setzero_ps();
 
-	/* How much memory do we need to align the data? */
-	vec_allocsize = count & 0xffffffffffffffe0U;
-	/* Only alloc/copy if not already aligned */
-	if (((uintptr_t)*data & (uintptr_t)0x0fULL) != 0) {
-		aligned_data  = (__m128i *)aligned_alloc(16, vec_allocsize);
-		if (!aligned_data) return 1;
-		memcpy(aligned_data, *data, vec_allocsize);
-	} else aligned_data = (__m128i *)*data;
-
-	for (size_t i = 0; i < (vec_allocsize / 16); i++) {
-		v1  = _mm_load_si128(&aligned_data[i]);
-		v3  = _mm_load_si128(&aligned_data[i]);
+	/* Data is read with unaligned loads so it never has to be copied */
+	vec_size = count & 0xffffffffffffffe0U;
+
+	for (size_t i = 0; i < (vec_size / 16); i++) {
+		v1  = _mm_loadu_si128(&vec_data[i]);
+		v3  = v1;
 		i++;
-		v4  = _mm_load_si128(&aligned_data[i]);
-		v6  = _mm_load_si128(&aligned_data[i]);
+		v4  = _mm_loadu_si128(&vec_data[i]);
+		v6  = v4;
 
 		/* "element2" gets RORed (two logical shifts ORed together) */
 		v1  = _mm_srli_epi64(v1, JODY_HASH_SHIFT);
@@ -104,9 +98,202 @@ int jody_block_hash_sse2(jodyhash_t **data, jodyhash_t *hash, const size_t count
 			*hash += ep1;
 			}  // End of hash finish loop
 		}  // End of main SSE for loop
-	*data += vec_allocsize / sizeof(jodyhash_t);
-	if (((uintptr_t)*data & (uintptr_t)0x0fULL) != 0) ALIGNED_FREE(aligned_data);
-	*length = (count - vec_allocsize) / sizeof(jodyhash_t);
+	*data += vec_size / sizeof(jodyhash_t);
+	*length = (count - vec_size) / sizeof(jodyhash_t);
+	return 0;
+}
+
+
+/* Advance two independent hashes by one word each (one per 64-bit lane) */
+#define SSE2_STEP(h, w) { \
+	v1 = _mm_or_si128(_mm_srli_epi64(w, JODY_HASH_SHIFT), _mm_slli_epi64(w, (64 - JODY_HASH_SHIFT))); \
+	v1 = _mm_xor_si128(v1, vec_ror2); \
+	v3 = _mm_add_epi64(w, vec_const); \
+	h = _mm_add_epi64(h, v3); \
+	h = _mm_xor_si128(h, v1); \
+	h = _mm_or_si128(_mm_slli_epi64(h, JH_SHIFT2), _mm_srli_epi64(h, (64 - JH_SHIFT2))); \
+	h = _mm_add_epi64(h, v3); \
+}
+
+/* Hash two equal-sized buffers at once, each in its own lane; returns the
+ * number of bytes hashed from each buffer (the rest is left to the caller) */
+size_t jody_block_hash_multi_sse2(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count)
+{
+	size_t vec_size;
+	const __m128i *d0 = (const __m128i *)data[0];
+	const __m128i *d1 = (const __m128i *)data[1];
+	__m128i vh, v1, v3, r0, r1, w0, w1;
+	__m128i vec_const, vec_ror2;
+
+#if defined __GNUC__ || defined __clang__
+	if (jody_hash_cpu_avx) asm volatile ("vzeroall" : : :
+			"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
+			"ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15");
+#endif /* __GNUC__ || __clang__ */
+
+	vec_const = _mm_load_si128(&vec_constant.v128[0]);
+	vec_ror2  = _mm_load_si128(&vec_constant_ror2.v128[0]);
+	vh = _mm_loadu_si128((const __m128i *)hash);
+
+	vec_size = count & 0xfffffffffffffff0U;
+
+	for (size_t i = 0; i < (vec_size / 16); i++) {
+		r0 = _mm_loadu_si128(&d0[i]);
+		r1 = _mm_loadu_si128(&d1[i]);
+		w0 = _mm_unpacklo_epi64(r0, r1);
+		w1 = _mm_unpackhi_epi64(r0, r1);
+		SSE2_STEP(vh, w0);
+		SSE2_STEP(vh, w1);
+	}
+
+	_mm_storeu_si128((__m128i *)hash, vh);
+	return vec_size;
+}
+
+
+/* Wide variant: eight interleaved accumulators in four registers, each
+ * taking the next two words of every 64-byte block */
+void jody_block_hash_wide_sse2(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks)
+{
+	const __m128i *vec_data = (const __m128i *)data;
+	__m128i h0, h1, h2, h3, v1, v3;
+	__m128i vec_const, vec_ror2;
+
+#if defined __GNUC__ || defined __clang__
+	if (jody_hash_cpu_avx) asm volatile ("vzeroall" : : :
+			"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
+			"ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15");
+#endif /* __GNUC__ || __clang__ */
+
+	vec_const = _mm_load_si128(&vec_constant.v128[0]);
+	vec_ror2  = _mm_load_si128(&vec_constant_ror2.v128[0]);
+	h0 = _mm_loadu_si128((const __m128i *)acc);
+	h1 = _mm_loadu_si128((const __m128i *)acc + 1);
+	h2 = _mm_loadu_si128((const __m128i *)acc + 2);
+	h3 = _mm_loadu_si128((const __m128i *)acc + 3);
+
+	for (size_t i = 0; i < blocks; i++) {
+		SSE2_STEP(h0, _mm_loadu_si128(&vec_data[i * 4]));
+		SSE2_STEP(h1, _mm_loadu_si128(&vec_data[i * 4 + 1]));
+		SSE2_STEP(h2, _mm_loadu_si128(&vec_data[i * 4 + 2]));
+		SSE2_STEP(h3, _mm_loadu_si128(&vec_data[i * 4 + 3]));
+	}
+
+	_mm_storeu_si128((__m128i *)acc, h0);
+	_mm_storeu_si128((__m128i *)acc + 1, h1);
+	_mm_storeu_si128((__m128i *)acc + 2, h2);
+	_mm_storeu_si128((__m128i *)acc + 3, h3);
+	return;
+}
+
+
+/* Offset of the first byte that differs, or count if the buffers match;
+ * 64 bytes are checked per loop with one branch */
+size_t jody_memdiff_sse2(const unsigned char *a, const unsigned char *b, const size_t count)
+{
+	__m128i e0, e1, e2, e3;
+	unsigned int mask;
+	size_t i = 0;
+
+#if defined __GNUC__ || defined __clang__
+	if (jody_hash_cpu_avx) asm volatile ("vzeroall" : : :
+			"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
+			"ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15");
+#endif /* __GNUC__ || __clang__ */
+
+	for (; i + 64 <= count; i += 64) {
+		e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)(a + i)), _mm_loadu_si128((const __m128i *)(const void *)(b + i)));
+		e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)(a + i + 16)), _mm_loadu_si128((const __m128i *)(const void *)(b + i + 16)));
+		e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)(a + i + 32)), _mm_loadu_si128((const __m128i *)(const void *)(b + i + 32)));
+		e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)(a + i + 48)), _mm_loadu_si128((const __m128i *)(const void *)(b + i + 48)));
+		if ((unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3))) != 0xffff) break;
+	}
+	for (; i + 16 <= count; i += 16) {
+		mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)(a + i)),
+				_mm_loadu_si128((const __m128i *)(const void *)(b + i))));
+		if (mask != 0xffff) return i + (size_t)__builtin_ctz(~mask);
+	}
+	for (; i < count; i++) if (a[i] != b[i]) break;
+	return i;
+}
+
+
+/* Length of the all-zero prefix (count if every byte is zero) */
+size_t jody_zero_span_sse2(const unsigned char *data, const size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v;
+	unsigned int mask;
+	size_t i = 0;
+
+#if defined __GNUC__ || defined __clang__
+	if (jody_hash_cpu_avx) asm volatile ("vzeroall" : : :
+			"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
+			"ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15");
+#endif /* __GNUC__ || __clang__ */
+
+	for (; i + 64 <= count; i += 64) {
+		v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i *)(const void *)(data + i)), _mm_loadu_si128((const __m128i *)(const void *)(data + i + 16))),
+				_mm_or_si128(_mm_loadu_si128((const __m128i *)(const void *)(data + i + 32)), _mm_loadu_si128((const __m128i *)(const void *)(data + i + 48))));
+		if ((unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xffff) break;
+	}
+	for (; i + 16 <= count; i += 16) {
+		mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(const void *)(data + i)), zero));
+		if (mask != 0xffff) return i + (size_t)__builtin_ctz(~mask);
+	}
+	for (; i < count; i++) if (data[i] != 0) break;
+	return i;
+}
+
+/* 128-bit variant: both lanes' per-word values are computed two words at
+ * a time; the two serial hash chains are then interleaved in scalar code */
+int jody_block_hash128_sse2(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
+{
+	size_t vec_size;
+	const __m128i *vec_data = (const __m128i *)*data;
+	__m128i w, a1, a3, b1, b3;
+	__m128i vec_const, vec_ror2, b_const, b_ror2;
+	union UINT256 ea1, ea2, eb1, eb2;
+	jodyhash_t a = hash[0], b = hash[1];
+
+#if defined __GNUC__ || defined __clang__
+	if (jody_hash_cpu_avx) asm volatile ("vzeroall" : : :
+			"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
+			"ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15");
+#endif /* __GNUC__ || __clang__ */
+
+	vec_const = _mm_load_si128(&vec_constant.v128[0]);
+	vec_ror2  = _mm_load_si128(&vec_constant_ror2.v128[0]);
+	b_const = _mm_set1_epi64x((long long)JODY_HASH128_CONSTANT);
+	b_ror2  = _mm_set1_epi64x((long long)JODY_HASH128_CONSTANT_ROR2);
+
+	vec_size = count & 0xfffffffffffffff0U;
+
+	for (size_t i = 0; i < (vec_size / 16); i++) {
+		w  = _mm_loadu_si128(&vec_data[i]);
+		a1 = _mm_xor_si128(_mm_or_si128(_mm_srli_epi64(w, JODY_HASH_SHIFT), _mm_slli_epi64(w, (64 - JODY_HASH_SHIFT))), vec_ror2);
+		a3 = _mm_add_epi64(w, vec_const);
+		b1 = _mm_xor_si128(_mm_or_si128(_mm_srli_epi64(w, JODY_HASH128_SHIFT), _mm_slli_epi64(w, (64 - JODY_HASH128_SHIFT))), b_ror2);
+		b3 = _mm_add_epi64(w, b_const);
+		_mm_store_si128(&ea1.v128[0], a3);
+		_mm_store_si128(&ea2.v128[0], a1);
+		_mm_store_si128(&eb1.v128[0], b3);
+		_mm_store_si128(&eb2.v128[0], b1);
+		for (int j = 0; j < 2; j++) {
+			a += ea1.v64[j];
+			b += eb1.v64[j];
+			a ^= ea2.v64[j];
+			b ^= eb2.v64[j];
+			a = JH_ROL2(a);
+			b = JH128_ROL2(b);
+			a += ea1.v64[j];
+			b += eb1.v64[j];
+		}
+	}
+	hash[0] = a;
+	hash[1] = b;
+	*data += vec_size / sizeof(jodyhash_t);
+	*length = (count - vec_size) / sizeof(jodyhash_t);
 	return 0;
 }
 
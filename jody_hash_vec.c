@@ -0,0 +1,187 @@
+/* Jody Bruchon's fast hashing function
+ *
+ * Portable vector kernel written with GCC/Clang vector extensions instead
+ * of CPU intrinsics. The compiler lowers it to whatever vector unit the
+ * target has (NEON, AltiVec, RVV, SSE2...) or to plain scalar code, so
+ * CPUs without a hand-written kernel still get the vectorized pre-mix.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "jody_hash.h"
+#include "jody_hash_simd.h"
+
+#ifndef NO_VEC
+
+/* Four 64-bit words, same shape as one AVX2 register */
+typedef uint64_t jh_vec __attribute__((vector_size(32)));
+
+#define VEC_WORDS (sizeof(jh_vec) / sizeof(jodyhash_t))
+
+static const jh_vec vec_const = { JODY_HASH_CONSTANT, JODY_HASH_CONSTANT, JODY_HASH_CONSTANT, JODY_HASH_CONSTANT };
+static const jh_vec vec_ror2 = { JH_ROR2(JODY_HASH_CONSTANT), JH_ROR2(JODY_HASH_CONSTANT),
+	JH_ROR2(JODY_HASH_CONSTANT), JH_ROR2(JODY_HASH_CONSTANT) };
+
+/* Vectors are never passed to or returned from functions since that
+ * would depend on the vector ABI of the target; memcpy() is turned into a
+ * plain vector load and keeps unaligned data safe on strict-alignment CPUs */
+#define VEC_LOAD(v, p) memcpy(&(v), (p), sizeof(jh_vec))
+
+/* Advance four independent hashes by one word each */
+#define VEC_STEP(h, w) { \
+	ve  = (w) + vec_const; \
+	ve2 = (((w) >> JODY_HASH_SHIFT) | ((w) << (64 - JODY_HASH_SHIFT))) ^ vec_ror2; \
+	h += ve; \
+	h ^= ve2; \
+	h = (h << JH_SHIFT2) | (h >> (64 - JH_SHIFT2)); \
+	h += ve; \
+}
+
+
+int jody_block_hash_vec(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
+{
+	size_t vec_size;
+	const unsigned char *p = (const unsigned char *)*data;
+	jh_vec w, e, e2;
+	jodyhash_t h = *hash;
+
+	vec_size = count & ~(sizeof(jh_vec) - 1);
+
+	for (size_t i = 0; i < vec_size; i += sizeof(jh_vec)) {
+		VEC_LOAD(w, p + i);
+		e  = w + vec_const;
+		e2 = ((w >> JODY_HASH_SHIFT) | (w << (64 - JODY_HASH_SHIFT))) ^ vec_ror2;
+		for (size_t j = 0; j < VEC_WORDS; j++) {
+			h += e[j];
+			h ^= e2[j];
+			h = JH_ROL2(h);
+			h += e[j];
+		}
+	}
+	*hash = h;
+	*data += vec_size / sizeof(jodyhash_t);
+	*length = (count - vec_size) / sizeof(jodyhash_t);
+	return 0;
+}
+
+
+/* Hash four equal-sized buffers at once, each in its own lane; returns the
+ * number of bytes hashed from each buffer (the rest is left to the caller) */
+size_t jody_block_hash_multi_vec(const jodyhash_t * const *data, jodyhash_t *hash, const size_t count)
+{
+	const size_t words = count / sizeof(jodyhash_t);
+	jodyhash_t w0, w1, w2, w3;
+	jh_vec vh, w, ve, ve2;
+
+	VEC_LOAD(vh, hash);
+	for (size_t i = 0; i < words; i++) {
+		memcpy(&w0, data[0] + i, sizeof(jodyhash_t));
+		memcpy(&w1, data[1] + i, sizeof(jodyhash_t));
+		memcpy(&w2, data[2] + i, sizeof(jodyhash_t));
+		memcpy(&w3, data[3] + i, sizeof(jodyhash_t));
+		w = (jh_vec){ w0, w1, w2, w3 };
+		VEC_STEP(vh, w);
+	}
+	memcpy(hash, &vh, sizeof(jh_vec));
+	return words * sizeof(jodyhash_t);
+}
+
+
+/* Wide variant: eight accumulators in two vectors, each taking the next
+ * four words of every 64-byte block */
+void jody_block_hash_wide_vec(const jodyhash_t *data, jodyhash_t *acc, const size_t blocks)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	jh_vec h0, h1, w0, w1, ve, ve2;
+
+	VEC_LOAD(h0, acc);
+	VEC_LOAD(h1, acc + VEC_WORDS);
+	for (size_t i = 0; i < blocks; i++) {
+		VEC_LOAD(w0, p);
+		VEC_LOAD(w1, p + sizeof(jh_vec));
+		VEC_STEP(h0, w0);
+		VEC_STEP(h1, w1);
+		p += sizeof(jh_vec) * 2;
+	}
+	memcpy(acc, &h0, sizeof(jh_vec));
+	memcpy(acc + VEC_WORDS, &h1, sizeof(jh_vec));
+	return;
+}
+
+
+/* Offset of the first byte that differs, or count if the buffers match */
+size_t jody_memdiff_vec(const unsigned char *a, const unsigned char *b, const size_t count)
+{
+	jh_vec x, y;
+	size_t i = 0;
+
+	for (; i + sizeof(jh_vec) <= count; i += sizeof(jh_vec)) {
+		VEC_LOAD(x, a + i);
+		VEC_LOAD(y, b + i);
+		x ^= y;
+		if ((x[0] | x[1] | x[2] | x[3]) != 0) break;
+	}
+	for (; i < count; i++) if (a[i] != b[i]) break;
+	return i;
+}
+
+
+/* Length of the all-zero prefix (count if every byte is zero) */
+size_t jody_zero_span_vec(const unsigned char *data, const size_t count)
+{
+	jh_vec x, y;
+	size_t i = 0;
+
+	for (; i + sizeof(jh_vec) * 2 <= count; i += sizeof(jh_vec) * 2) {
+		VEC_LOAD(x, data + i);
+		VEC_LOAD(y, data + i + sizeof(jh_vec));
+		x |= y;
+		if ((x[0] | x[1] | x[2] | x[3]) != 0) break;
+	}
+	for (; i < count; i++) if (data[i] != 0) break;
+	return i;
+}
+
+/* 128-bit variant: both lanes' per-word values are computed four words at
+ * a time; the two serial hash chains are then interleaved */
+int jody_block_hash128_vec(const jodyhash_t **data, jodyhash_t *hash, const size_t count, size_t *length)
+{
+	static const jh_vec b_const = { JODY_HASH128_CONSTANT, JODY_HASH128_CONSTANT,
+		JODY_HASH128_CONSTANT, JODY_HASH128_CONSTANT };
+	static const jh_vec b_ror2 = { JODY_HASH128_CONSTANT_ROR2, JODY_HASH128_CONSTANT_ROR2,
+		JODY_HASH128_CONSTANT_ROR2, JODY_HASH128_CONSTANT_ROR2 };
+	size_t vec_size;
+	const unsigned char *p = (const unsigned char *)*data;
+	jh_vec w, ea1, ea2, eb1, eb2;
+	jodyhash_t a = hash[0], b = hash[1];
+
+	vec_size = count & ~(sizeof(jh_vec) - 1);
+
+	for (size_t i = 0; i < vec_size; i += sizeof(jh_vec)) {
+		VEC_LOAD(w, p + i);
+		ea1 = w + vec_const;
+		ea2 = ((w >> JODY_HASH_SHIFT) | (w << (64 - JODY_HASH_SHIFT))) ^ vec_ror2;
+		eb1 = w + b_const;
+		eb2 = ((w >> JODY_HASH128_SHIFT) | (w << (64 - JODY_HASH128_SHIFT))) ^ b_ror2;
+		for (size_t j = 0; j < VEC_WORDS; j++) {
+			a += ea1[j];
+			b += eb1[j];
+			a ^= ea2[j];
+			b ^= eb2[j];
+			a = JH_ROL2(a);
+			b = JH128_ROL2(b);
+			a += ea1[j];
+			b += eb1[j];
+		}
+	}
+	hash[0] = a;
+	hash[1] = b;
+	*data += vec_size / sizeof(jodyhash_t);
+	*length = (count - vec_size) / sizeof(jodyhash_t);
+	return 0;
+}
+
+#endif /* NO_VEC */
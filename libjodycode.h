@@ -22,9 +22,9 @@ extern "C" {
  * supports the used interfaces should be chosen by programs that check
  * version information for compatibility. See README for more information. */
 #define LIBJODYCODE_API_VERSION       3
-#define LIBJODYCODE_API_FEATURE_LEVEL 2
-#define LIBJODYCODE_VER               "3.1"
-#define LIBJODYCODE_VERDATE           "2023-07-02"
+#define LIBJODYCODE_API_FEATURE_LEVEL 3
+#define LIBJODYCODE_VER               "3.2"
+#define LIBJODYCODE_VERDATE           "2026-10-17"
 
 /* API sub-version table
  * This table tells programs about API changes so that programs can detect
@@ -44,10 +44,13 @@ extern "C" {
 #define LIBJODYCODE_WIN_UNICODE_VER 2
 #define LIBJODYCODE_ERROR_VER       1
 #define LIBJODYCODE_ALARM_VER       1
+#define LIBJODYCODE_HASHTABLE_VER   1
+#define LIBJODYCODE_COMPARE_VER     1
 
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 #ifdef ON_WINDOWS
@@ -113,6 +116,34 @@ extern void jc_get_proc_cacheinfo(struct jc_proc_cacheinfo *pci);
 #endif /* __linux__ */
 
 
+/*** compare ***/
+
+/* File comparison; flags pick the read method like JC_HASH_FILE_* and
+ * JC_COMPARE_SAMPLE checks the tail and head before everything else
+ * As with hashing, AUTO maps files of 16 MiB and up, and a mapped file
+ * that is truncated during the comparison raises SIGBUS; use PREAD for
+ * files that may shrink. */
+#define JC_COMPARE_AUTO   0x00
+#define JC_COMPARE_PREAD  0x01
+#define JC_COMPARE_MMAP   0x02
+#define JC_COMPARE_SAMPLE 0x04
+
+extern size_t jc_memdiff(const void *a, const void *b, const size_t count);
+extern int jc_files_equal(int fd_a, int fd_b, off_t length, int flags, off_t *diff);
+
+/* Lockstep comparison of a whole group of candidate files; each file is
+ * used from fd or, if fd is negative, opened from path. Afterwards group
+ * is the lowest index of the files identical to this one. */
+struct jc_compare_file {
+	const char *path;
+	int fd;
+	size_t group;
+	int status;
+};
+
+extern int jc_files_group(struct jc_compare_file *files, const size_t count, const off_t length, unsigned int max_open);
+
+
 /*** error ***/
 
 extern const char *jc_get_errname(int errnum);
@@ -126,12 +157,272 @@ extern int jc_print_error(int errnum);
 #ifndef JODY_HASH_VERSION
 #define JODY_HASH_VERSION 7
 #endif
+/* Chunked tree hashes are not v7 hashes and are versioned separately */
+#ifndef JODY_HASH_TREE_VERSION
+#define JODY_HASH_TREE_VERSION 1
+#define JODY_HASH_TREE_CHUNK 1048576
+#endif
+/* So are hashes from the lane-parallel "wide" variant */
+#ifndef JODY_HASH_WIDE_VERSION
+#define JODY_HASH_WIDE_VERSION 1
+#define JODY_HASH_WIDE_LANES 8
+#endif
+/* Content-defined chunk boundaries; the chunk hashes are v7 hashes */
+#ifndef JODY_HASH_CDC_VERSION
+#define JODY_HASH_CDC_VERSION 1
+#endif
+/* Sampled quick fingerprints only match other fingerprints */
+#ifndef JODY_HASH_SAMPLE_VERSION
+#define JODY_HASH_SAMPLE_VERSION 1
+#endif
+/* The second half of a 128-bit hash has its own version; the first half
+ * is always a normal JODY_HASH_VERSION hash */
+#ifndef JODY_HASH128_VERSION
+#define JODY_HASH128_VERSION 1
+#endif
 
 /* Width of a jody_hash */
 #define JODY_HASH_WIDTH 64
 typedef uint64_t jodyhash_t;
 
 extern int jc_block_hash(jodyhash_t *data, jodyhash_t *hash, const size_t count);
+/* Hash equal-sized buffers in parallel SIMD lanes; hash[i] is the same as
+ * jc_block_hash(data[i], &hash[i], count) */
+extern int jc_block_hash_multi(jodyhash_t * const *data, jodyhash_t *hash, const size_t buffers, const size_t count);
+/* Much faster single-buffer variant that does NOT produce v7 hashes; the
+ * whole buffer must be hashed in one call (*hash is a seed, normally 0) */
+extern int jc_block_hash_wide(const void *data, jodyhash_t *hash, const size_t count);
+/* 128-bit hash in hash[0..1] with far fewer false matches; hash[0] is the
+ * same as jc_block_hash() and blocks chain the same way */
+extern int jc_block_hash128(const jodyhash_t *data, jodyhash_t *hash, const size_t count);
+
+/* Inline hash for short keys such as path names and small records
+ * Returns what jc_block_hash(data, &hash, count) would leave in hash on
+ * little-endian CPUs, but skips the kernel dispatch, and the data doesn't
+ * need to be aligned or padded: nothing past the last byte is ever read.
+ * Any length works; past about 64 bytes jc_block_hash() is faster. */
+#define JC_HASH_SMALL_CONSTANT 0x71812e0f5463d3c8ULL
+#define JC_HASH_SMALL_ROR(a, n) (((a) >> (n)) | ((a) << (64 - (n))))
+
+static inline jodyhash_t jc_hash_bytes_small(const void *data, const size_t count, jodyhash_t hash)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	const size_t tail = count & 7;
+	uint64_t w, e, e2;
+	uint32_t lo, hi;
+
+	for (size_t i = 0; i + 8 <= count; i += 8) {
+		memcpy(&w, p + i, 8);
+		e = w + JC_HASH_SMALL_CONSTANT;
+		e2 = JC_HASH_SMALL_ROR(w, 14) ^ JC_HASH_SMALL_ROR(JC_HASH_SMALL_CONSTANT, 28);
+		hash += e;
+		hash ^= e2;
+		hash = JC_HASH_SMALL_ROR(hash, 36);
+		hash += e;
+	}
+	if (tail == 0) return hash;
+
+	/* Gather the last 1-7 bytes with loads that stay inside the data */
+	if (count >= 8) {
+		memcpy(&w, p + count - 8, 8);
+		w >>= (8 - tail) * 8;
+	} else if (tail >= 4) {
+		memcpy(&lo, p, 4);
+		memcpy(&hi, p + tail - 4, 4);
+		w = (uint64_t)lo | (((uint64_t)hi >> ((8 - tail) * 8)) << 32);
+	} else w = (uint64_t)p[0] | ((uint64_t)p[tail / 2] << ((tail / 2) * 8)) | ((uint64_t)p[tail - 1] << ((tail - 1) * 8));
+
+	e = w + JC_HASH_SMALL_CONSTANT;
+	e2 = JC_HASH_SMALL_ROR(w, 14) ^ JC_HASH_SMALL_ROR(JC_HASH_SMALL_CONSTANT, 28);
+	hash += e;
+	hash ^= e2;
+	hash = JC_HASH_SMALL_ROR(hash, 36);
+	return hash + e2;
+}
+
+/* Hash kernel selection; AUTO picks the fastest kernel for this CPU
+ * The JODY_HASH_KERNEL environment variable can force one at load time
+ * Setting a kernel that isn't built in or supported by the CPU fails
+ * The kernel may be switched while other threads are hashing; every
+ * kernel gives the same results, so this only changes the speed */
+#define JC_HASH_KERNEL_AUTO   0
+#define JC_HASH_KERNEL_SCALAR 1
+#define JC_HASH_KERNEL_SSE2   2
+#define JC_HASH_KERNEL_AVX2   3
+#define JC_HASH_KERNEL_AVX512 4
+#define JC_HASH_KERNEL_VEC    5
+
+extern int jc_set_hash_kernel(const int kernel);
+extern int jc_get_hash_kernel(void);
+
+/* Streaming hash context for data of any length split up in any way
+ * The result matches a single jc_block_hash() over all of the data
+ * jc_hash_final() does not change the context; more data can follow */
+struct jc_hash_ctx {
+	jodyhash_t hash;
+	uint64_t length;
+	jodyhash_t tail;
+	unsigned int tail_len;
+};
+
+extern void jc_hash_init(struct jc_hash_ctx *ctx);
+extern int jc_hash_update(struct jc_hash_ctx *ctx, const void *data, size_t count);
+extern void jc_hash_final(const struct jc_hash_ctx *ctx, jodyhash_t *hash);
+
+/* File hashing: reads with pread() or mmap() and hashes 'length' bytes
+ * starting at 'offset'; length 0 hashes to EOF. Flags can force a
+ * particular read method; the default picks one based on the size.
+ * SPARSE finds holes with SEEK_DATA/SEEK_HOLE and hashes zeroes for them
+ * without reading; it always uses pread() and gives the same hashes.
+ * DIRECT reads with O_DIRECT so the page cache is left alone, or acts
+ * like NOCACHE where O_DIRECT can't be used. O_DIRECT is turned on for
+ * the open file while hashing, which also affects other threads and
+ * dup()ed fds reading from it at the same time. NOCACHE drops data from
+ * the cache after hashing it. Both always read instead of mapping.
+ * A mapped file (MMAP, or AUTO for 16 MiB and up, also in tree hashing)
+ * raises SIGBUS if it is truncated while being hashed; use PREAD for
+ * files that may shrink. Pipes and other fds that can't be read at an
+ * offset are read from their current position and 'offset' is ignored.
+ * RESIDENT_FIRST only affects jc_hash_files(); see below. */
+#define JC_HASH_FILE_AUTO    0x00
+#define JC_HASH_FILE_PREAD   0x01
+#define JC_HASH_FILE_MMAP    0x02
+#define JC_HASH_FILE_SPARSE  0x04
+#define JC_HASH_FILE_DIRECT  0x08
+#define JC_HASH_FILE_NOCACHE 0x10
+#define JC_HASH_FILE_RESIDENT_FIRST 0x20
+
+extern int jc_hash_fd_update(struct jc_hash_ctx *ctx, int fd, off_t offset, off_t length, int flags);
+extern int jc_hash_fd(int fd, off_t offset, off_t length, int flags, jodyhash_t *hash);
+extern int jc_hash_file(const char *path, off_t offset, off_t length, int flags, jodyhash_t *hash);
+
+/* Zero statistics from sparse hashing; zero blocks are aligned blocks of
+ * read data that are all zeroes and could have been holes. A run is a
+ * stretch of adjacent holes and zero blocks. */
+#define JC_HASH_ZERO_BLOCK 4096
+struct jc_hash_zero_stats {
+	uint64_t data_bytes;
+	uint64_t hole_bytes;
+	uint64_t holes;
+	uint64_t zero_bytes;
+	uint64_t zero_runs;
+	uint64_t longest_run;
+};
+extern int jc_hash_fd_sparse(struct jc_hash_ctx *ctx, int fd, off_t offset, off_t length, struct jc_hash_zero_stats *stats);
+
+/* Single-pass hashing with the running hash reported at several offsets
+ * Resumes from ctx->length so a saved partial hash can be continued */
+#define JC_HASH_EOF -1
+extern int jc_hash_fd_checkpoints(struct jc_hash_ctx *ctx, int fd, const off_t *checkpoints, jodyhash_t *hashes, const int count, int flags);
+
+/* Save/restore hashing state so appended files only need the new data
+ * hashed; state is a JC_HASH_STATE_SIZE byte, version-checked blob */
+#define JC_HASH_STATE_SIZE 48
+extern int jc_hash_state_save(const struct jc_hash_ctx *ctx, int fd, unsigned char *state);
+extern int jc_hash_state_load(struct jc_hash_ctx *ctx, const unsigned char *state);
+extern int jc_hash_fd_resume(struct jc_hash_ctx *ctx, int fd, const unsigned char *state, int flags);
+
+/* Parallel hashing of many files; each job is hashed from its fd or, if
+ * fd is negative, by opening its path. Length 0 hashes the whole file.
+ * jc_hash_files() returns the number of jobs with a nonzero status. */
+struct jc_hash_job {
+	const char *path;
+	int fd;
+	off_t length;
+	jodyhash_t hash;
+	int status;
+};
+
+extern int jc_hash_files(struct jc_hash_job *jobs, const size_t count, const unsigned int threads, const int flags);
+extern int jc_hash_files_async(struct jc_hash_job *jobs, const size_t count, unsigned int depth, const int flags);
+
+/* Page cache residency: how much of a file range is cached already, and
+ * a job order that puts cached files first (least disk I/O first).
+ * jc_hash_files() with JC_HASH_FILE_RESIDENT_FIRST uses that order and
+ * reads ahead in cold files while earlier jobs are being hashed. */
+extern int jc_file_resident(int fd, off_t offset, off_t length, uint64_t *resident, uint64_t *total);
+extern int jc_hash_order_resident(const struct jc_hash_job *jobs, const size_t count, size_t *order, uint64_t *uncached);
+
+/* Chunked tree hashing: chunks are hashed in parallel on 'threads' threads
+ * (0 = one per CPU) and the chunk hashes are then hashed in order */
+extern int jc_hash_tree(const void *data, const size_t count, const unsigned int threads, jodyhash_t *hash);
+extern int jc_hash_tree_fd(int fd, off_t length, const unsigned int threads, int flags, jodyhash_t *hash);
+extern int jc_hash_tree_file(const char *path, off_t length, const unsigned int threads, int flags, jodyhash_t *hash);
+
+/* Content-defined chunking: cut points come from a rolling hash of the
+ * data, so shifted copies of a region still produce the same chunks.
+ * func() gets each chunk in order; nonzero from it stops chunking. */
+#define JC_HASH_CHUNK_AVG 8192
+struct jc_chunk {
+	uint64_t offset;
+	uint64_t length;
+	jodyhash_t hash;
+};
+
+extern int jc_hash_chunk(const void *data, const size_t count, const size_t min, const size_t avg, const size_t max,
+		int (*func)(const struct jc_chunk *chunk, void *arg), void *arg);
+extern int jc_hash_chunk_fd(int fd, const size_t min, const size_t avg, const size_t max,
+		int (*func)(const struct jc_chunk *chunk, void *arg), void *arg);
+
+/* Quick fingerprints from the first, last and evenly spaced blocks plus
+ * the size; only useful for telling files apart (0 = default layout) */
+#define JC_HASH_SAMPLE_BLOCKS     4
+#define JC_HASH_SAMPLE_BLOCK_SIZE 16384
+extern int jc_hash_sample(int fd, off_t size, unsigned int blocks, size_t block_size, jodyhash_t *hash);
+extern int jc_hash_sample_files(struct jc_hash_job *jobs, const size_t count, unsigned int blocks, size_t block_size, unsigned int depth);
+
+/* Persistent hash cache; entries are keyed by dev, ino, size and mtime
+ * and a cache file only holds hashes for one JODY_HASH_VERSION */
+#define JC_HASH_CACHE_PARTIAL    0x01
+#define JC_HASH_CACHE_FULL       0x02
+#define JC_HASH_CACHE_SAVE_PRUNE 0x01
+
+struct jc_hash_cache;
+struct jc_hash_cache_entry {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime;
+	uint32_t mtime_nsec;
+	uint32_t flags;
+	uint64_t partial_len;
+	jodyhash_t partial_hash;
+	jodyhash_t full_hash;
+};
+
+extern int jc_hash_cache_open(const char *path, struct jc_hash_cache **cache);
+extern void jc_hash_cache_close(struct jc_hash_cache *cache);
+#ifndef ON_WINDOWS
+extern void jc_hash_cache_set_key(struct jc_hash_cache_entry *entry, const struct stat *st);
+#endif
+extern int jc_hash_cache_get(struct jc_hash_cache *cache, struct jc_hash_cache_entry *entry);
+extern size_t jc_hash_cache_get_many(struct jc_hash_cache *cache, struct jc_hash_cache_entry *entries, const size_t count);
+extern int jc_hash_cache_put(struct jc_hash_cache *cache, const struct jc_hash_cache_entry *entry);
+extern int jc_hash_cache_save(struct jc_hash_cache *cache, const int flags);
+
+/* Lock-free hash cache shared by concurrent processes through a file
+ * (use /dev/shm for shared memory); only key fields of 'key' are used */
+#ifndef ON_WINDOWS
+struct jc_hash_shm;
+extern int jc_hash_shm_open(const char *path, uint64_t slots, struct jc_hash_shm **shm);
+extern void jc_hash_shm_close(struct jc_hash_shm *shm);
+extern int jc_hash_shm_get(struct jc_hash_shm *shm, const struct jc_hash_cache_entry *key, jodyhash_t *hash);
+extern int jc_hash_shm_put(struct jc_hash_shm *shm, const struct jc_hash_cache_entry *key, const jodyhash_t hash);
+#endif
+
+
+/*** hashtable ***/
+
+/* Open addressing table grouping 64-bit values by jodyhash_t key */
+struct jc_hashtable;
+extern int jc_hashtable_init(struct jc_hashtable **table, const size_t expected);
+extern void jc_hashtable_free(struct jc_hashtable *ht);
+extern int jc_hashtable_insert(struct jc_hashtable *ht, const jodyhash_t key, const uint64_t value);
+extern int jc_hashtable_insert_many(struct jc_hashtable *ht, const jodyhash_t *keys, const uint64_t *values, const size_t count);
+extern size_t jc_hashtable_lookup(const struct jc_hashtable *ht, const jodyhash_t key, uint64_t *values, const size_t max);
+extern int jc_hashtable_foreach_group(const struct jc_hashtable *ht, const size_t min_count,
+		int (*func)(const jodyhash_t key, const uint64_t *values, const size_t count, void *arg), void *arg);
+extern void jc_hashtable_stats(const struct jc_hashtable *ht, size_t *entries, size_t *groups);
 
 
 /*** oom ***/
@@ -190,6 +481,11 @@ extern const char *jc_verdate;
 extern const int jc_api_version;
 extern const int jc_api_featurelevel;
 extern const int jc_jodyhash_version;
+extern const int jc_jodyhash_tree_version;
+extern const int jc_jodyhash_wide_version;
+extern const int jc_jodyhash_cdc_version;
+extern const int jc_jodyhash_sample_version;
+extern const int jc_jodyhash128_version;
 /* This table is used for API compatibility checks */
 extern const unsigned char jc_api_versiontable[];
 
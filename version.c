@@ -11,6 +11,11 @@ const char *jc_verdate = LIBJODYCODE_VERDATE;
 const int jc_api_version = LIBJODYCODE_API_VERSION;
 const int jc_api_featurelevel = LIBJODYCODE_API_FEATURE_LEVEL;
 const int jc_jodyhash_version = JODY_HASH_VERSION;
+const int jc_jodyhash_tree_version = JODY_HASH_TREE_VERSION;
+const int jc_jodyhash_wide_version = JODY_HASH_WIDE_VERSION;
+const int jc_jodyhash_cdc_version = JODY_HASH_CDC_VERSION;
+const int jc_jodyhash_sample_version = JODY_HASH_SAMPLE_VERSION;
+const int jc_jodyhash128_version = JODY_HASH128_VERSION;
 
 /* API sub-version info array, terminated with 0
  * Valid versions are 1-254. New API sections MUST be added to the end. The
@@ -28,5 +33,7 @@ const unsigned char jc_api_versiontable[] = {
 	LIBJODYCODE_WIN_UNICODE_VER,
 	LIBJODYCODE_ERROR_VER,
 	LIBJODYCODE_ALARM_VER,
+	LIBJODYCODE_HASHTABLE_VER,
+	LIBJODYCODE_COMPARE_VER,
 	0
 };
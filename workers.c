@@ -0,0 +1,67 @@
+/* Worker thread helper
+ *
+ * Starts a group of threads that all run the same function; the
+ * function is expected to pull work items from a shared counter.
+ *
+ * Copyright (C) 2026 by Jody Bruchon <jody@jodybruchon.com>
+ * Released under The MIT License
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "workers.h"
+#ifdef JC_THREADS
+ #include <pthread.h>
+#endif
+
+/* Upper limit on threads; more than this won't help any I/O workload */
+#define MAX_WORKERS 256
+
+
+/* Turn a requested thread count into the number that will really run */
+extern unsigned int jc_worker_count(unsigned int threads)
+{
+#ifdef JC_THREADS
+	long cpus;
+
+	if (threads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? (unsigned int)cpus : 1;
+	}
+	if (threads > MAX_WORKERS) threads = MAX_WORKERS;
+	return threads;
+#else
+	(void)threads;
+	return 1;
+#endif
+}
+
+
+/* If some threads fail to start, the rest of the threads (including the
+ * caller) still do all of the work */
+extern void jc_run_workers(unsigned int threads, void *(*func)(void *), void *arg)
+{
+#ifdef JC_THREADS
+	pthread_t *tid;
+	unsigned int i, started = 0;
+
+	threads = jc_worker_count(threads);
+	if (threads > 1) {
+		tid = (pthread_t *)malloc(sizeof(pthread_t) * (threads - 1));
+		if (tid != NULL) {
+			for (i = 0; i < threads - 1; i++) {
+				if (pthread_create(&tid[started], NULL, func, arg) != 0) break;
+				started++;
+			}
+		}
+		func(arg);
+		for (i = 0; i < started; i++) pthread_join(tid[i], NULL);
+		free(tid);
+		return;
+	}
+#else
+	(void)threads;
+#endif
+	func(arg);
+	return;
+}
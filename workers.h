@@ -0,0 +1,32 @@
+/* Worker thread helper (internal to libjodycode)
+ * See workers.c for license information */
+
+#ifndef JC_WORKERS_H
+#define JC_WORKERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Threads are only used with GCC/Clang atomics and POSIX threads */
+#if !defined ON_WINDOWS && (defined __GNUC__ || defined __clang__)
+ #define JC_THREADS
+ #define JC_ATOMIC_NEXT(a) __atomic_fetch_add(&(a), 1, __ATOMIC_RELAXED)
+ #define JC_ATOMIC_SET(a, v) __atomic_store_n(&(a), (v), __ATOMIC_RELAXED)
+ #define JC_ATOMIC_GET(a) __atomic_load_n(&(a), __ATOMIC_RELAXED)
+#else
+ #define JC_ATOMIC_NEXT(a) ((a)++)
+ #define JC_ATOMIC_SET(a, v) ((a) = (v))
+ #define JC_ATOMIC_GET(a) (a)
+#endif
+
+/* Run func(arg) on 'threads' threads (the caller is one of them) and
+ * wait for all of them to finish; threads = 0 uses one per online CPU */
+extern void jc_run_workers(unsigned int threads, void *(*func)(void *), void *arg);
+extern unsigned int jc_worker_count(unsigned int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JC_WORKERS_H */